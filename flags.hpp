@@ -7,15 +7,90 @@
 #include <unordered_map>
 #include <charconv>
 #include <thread>
-#include <list>
+#include <deque>
 #include <optional>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <type_traits>
+
+#if __has_include(<unistd.h>) && __has_include(<sys/mman.h>)
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define FLAG_HAS_POSIX 1
+#endif
 
 namespace flag
 {
     // the type of a Flag
     enum Type : uint8_t 
     {
-        String, Number, Bool 
+        String, Number, Bool, 
+        // comma separated lists. every use of the flag appends to the list
+        StringList, NumberList, 
+        // a comma separated list of floats stored in a 64 byte aligned buffer for vector loads
+        NumberArray, 
+        // a set of integers like 0-3,8,12-15 stored as a bitmap. every use of the flag adds to the set
+        Ranges, 
+        // key=value pairs. a map flag named D also matches -Dkey=value and one named limit-* matches --limit-key=value. every use of the flag adds to the map
+        Map, 
+        // a whole number with a unit like 64MiB or 250ms. stored as a uint64_t count of bytes or nanoseconds
+        Size, Duration, 
+        // one of the values in Flag::choices. stored as the uint64_t position of the value in the list
+        Choice, 
+        // the number of times the flag was used, like -vvv. stored as a uint64_t and takes no value
+        Count
+    };
+
+    // how many flags of a group may be set
+    enum GroupRule : uint8_t
+    {
+        ExactlyOne,
+        AtMostOne,
+        AtLeastOne
+    };
+
+    // what happens when a flag is used more than once
+    enum Repeat : uint8_t
+    {
+        // the last value is kept
+        LastWins,
+        // the first value is kept and later ones are ignored
+        FirstWins,
+        // parsing fails
+        Reject,
+        // every value is kept and can be read with Parser::values. list, Ranges, Map and Count flags already keep every value so for them it is the same as LastWins
+        Accumulate
+    };
+
+    // a unit suffix and the number of bytes or nanoseconds it stands for
+    struct Unit
+    {
+        std::string_view suffix;
+        uint64_t scale;
+    };
+
+    // the suffixes Size flags accept. K, M, G and T are powers of 1024 like KiB
+    inline constexpr Unit size_units[] = {
+        {"", 1}, {"B", 1},
+        {"K", 1ull << 10}, {"KiB", 1ull << 10}, {"KB", 1000},
+        {"M", 1ull << 20}, {"MiB", 1ull << 20}, {"MB", 1000'000},
+        {"G", 1ull << 30}, {"GiB", 1ull << 30}, {"GB", 1000'000'000},
+        {"T", 1ull << 40}, {"TiB", 1ull << 40}, {"TB", 1000'000'000'000},
+    };
+
+    // the suffixes Duration flags accept. only 0 can be given without one
+    inline constexpr Unit duration_units[] = {
+        {"ns", 1}, {"us", 1000}, {"ms", 1000'000}, {"s", 1000'000'000},
+        {"m", 60'000'000'000}, {"h", 3600'000'000'000}, {"d", 86400'000'000'000},
     };
 
     struct Result
@@ -28,288 +103,3345 @@ namespace flag
         std::string_view error;
     };
 
-    // the variant used to store flag data
-    using FlagData = std::variant<std::string_view, double, bool>;
+    // a set of non negative integers stored as a bitmap. the value of Ranges flags
+    class RangeSet
+    {
+    public:
+        // one past the largest value a set can hold. keeps a mistyped value from allocating gigabytes
+        static constexpr uint32_t limit = 1 << 24;
+
+        bool contains(uint64_t value) const
+        {
+            return value / 64 < m_bits.size() && (m_bits[value / 64] >> (value % 64)) & 1;
+        }
+
+        bool empty() const
+        {
+            return count() == 0;
+        }
+
+        size_t count() const
+        {
+            size_t total = 0;
+
+            for (uint64_t word : m_bits)
+                total += std::popcount(word);
+
+            return total;
+        }
+
+        // calls fn with every value in the set in increasing order
+        template <typename Fn>
+        void for_each(Fn &&fn) const
+        {
+            for (size_t w = 0; w < m_bits.size(); w++)
+            {
+                for (uint64_t bits = m_bits[w]; bits; bits &= bits - 1)
+                    fn(uint32_t(w * 64 + std::countr_zero(bits)));
+            }
+        }
+
+        // adds every value in [first, last]. last must be below limit
+        void insert(uint32_t first, uint32_t last)
+        {
+            size_t first_word = first / 64;
+            size_t last_word  = last / 64;
+
+            if (last_word >= m_bits.size())
+                m_bits.resize(last_word + 1);
+
+            uint64_t head = ~uint64_t(0) << (first % 64);
+            uint64_t tail = ~uint64_t(0) >> (63 - last % 64);
+
+            if (first_word == last_word)
+            {
+                m_bits[first_word] |= head & tail;
+                return;
+            }
+
+            m_bits[first_word] |= head;
+
+            for (size_t w = first_word + 1; w < last_word; w++)
+                m_bits[w] = ~uint64_t(0);
+
+            m_bits[last_word] |= tail;
+        }
+
+        // the bitmap. bit n of word n / 64 is set if n is in the set
+        std::span<const uint64_t> bits() const
+        {
+            return m_bits;
+        }
+
+        void reserve(uint32_t end)
+        {
+            if ((end + 63) / 64 > m_bits.size())
+                m_bits.resize((end + 63) / 64);
+        }
+
+    private:
+        std::vector<uint64_t> m_bits;
+    };
+
+    class FlatMap;
+
+    // the variant used to store flag data
+    using FlagData = std::variant<std::string_view, double, bool, std::span<const std::string_view>, std::span<const double>, std::span<const float>, const RangeSet*, const FlatMap*, uint64_t>;
+
+    // a pointer to a variable that the flag value is written to when the flag is set. the pointer type must match the flag type.
+    using FlagTarget = std::variant<std::monostate, std::string_view*, double*, bool*, std::span<const std::string_view>*, std::span<const double>*, std::span<const float>*, const RangeSet**, const FlatMap**, uint64_t*>;
+
+    // set() matches a target to its flag by index, so every target alternative must point to the data alternative in the same place after monostate
+    static_assert([]<size_t... I>(std::index_sequence<I...>)
+    {
+        return std::variant_size_v<FlagTarget> == std::variant_size_v<FlagData> + 1 &&
+            (std::is_same_v<std::variant_alternative_t<I + 1, FlagTarget>, std::variant_alternative_t<I, FlagData>*> && ...);
+    }(std::make_index_sequence<std::variant_size_v<FlagData>>{}));
+
+    // binds a flag to a field of a struct. after parsing the value can be read from the struct without any lookups.
+    template <typename S, typename T>
+    FlagTarget bind(S &object, T S::*field)
+    {
+        return &(object.*field);
+    }
+
+    // an allocator for buffers that need to be aligned for vector loads
+    template <typename T, size_t Align = 64>
+    struct AlignedAllocator
+    {
+        using value_type = T;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U, Align>;
+        };
+
+        AlignedAllocator() = default;
+
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Align>&)
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+        }
+
+        void deallocate(T *p, size_t)
+        {
+            ::operator delete(p, std::align_val_t{Align});
+        }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U, Align>&) const
+        {
+            return true;
+        }
+    };
+
+    // limits on the values of String and StringList flags. checked as each value is set
+    struct Check
+    {
+        // the fewest and most bytes a value may have
+        size_t min_length = 0;
+        size_t max_length = SIZE_MAX;
+        // the bytes a value may contain, written like a bracket expression without the brackets: "a-z0-9_-". any byte is allowed when empty
+        std::string_view charset;
+        /*
+        * a regular expression the whole value must match. a small subset is supported:
+
+        * literals, ., [a-z] and [^a-z] classes, \d \w \s, grouping with (), | and the * + ? quantifiers.
+        */
+        std::string_view pattern;
+    };
+
+    /*
+    * a Check compiled for fast matching. the charset is a 256 bit table and the pattern a DFA over byte classes, so a value is checked in one pass with no allocation.
+
+    * when both are given the charset is folded into the DFA so each byte costs one table load.
+
+    * a pattern that cannot be compiled, or needs more than max_states states, makes every value fail with an error saying so.
+    */
+    class Validator
+    {
+    public:
+        static constexpr size_t max_states = 4096;
+
+        explicit Validator(const Check &check)
+            : m_min(check.min_length), m_max(check.max_length)
+        {
+            if (!check.charset.empty())
+            {
+                size_t pos = 0;
+
+                m_has_charset = parse_class(check.charset, pos, m_charset) && pos == check.charset.size();
+
+                if (!m_has_charset)
+                    m_error = "invalid charset in flag check";
+            }
+
+            if (!check.pattern.empty() && m_error.empty() && !compile(check.pattern))
+                m_error = "invalid pattern in flag check";
+
+            m_has_pattern = !check.pattern.empty();
+        }
+
+        // returns an empty view if value passes, otherwise the reason it does not
+        std::string_view check(std::string_view value) const
+        {
+            if (!m_error.empty())
+                return m_error;
+
+            if (value.size() < m_min)
+                return "value is too short";
+
+            if (value.size() > m_max)
+                return "value is too long";
+
+            if (!m_has_pattern)
+                return allowed(value) ? std::string_view{} : "value contains a character that is not allowed";
+
+            // the dead state moves to itself so there is no need to stop early
+            uint32_t row = m_start;
+
+            for (unsigned char c : value)
+                row = m_next[row + m_class[c]];
+
+            if (m_accept[row / m_classes])
+                return {};
+
+            if (!allowed(value))
+                return "value contains a character that is not allowed";
+
+            return "value does not match the pattern";
+        }
+
+    private:
+        using Bytes = std::array<uint64_t, 4>;
+
+        // the DFA state every failed match ends in
+        static constexpr uint32_t dead = 0;
+
+        size_t m_min;
+        size_t m_max;
+        bool m_has_charset = false;
+        bool m_has_pattern = false;
+        Bytes m_charset{};
+        // the byte class of every byte. bytes in a class move every state to the same state
+        std::array<uint32_t, 256> m_class{};
+        uint32_t m_classes = 0;
+        // the row of the next state for every state row and byte class. a state's row is its number times m_classes
+        std::vector<uint32_t> m_next;
+        std::vector<uint8_t> m_accept;
+        uint32_t m_start = dead;
+        std::string_view m_error;
+
+        bool allowed(std::string_view value) const
+        {
+            if (!m_has_charset)
+                return true;
+
+            for (unsigned char c : value)
+            {
+                if (!test(m_charset, c))
+                    return false;
+            }
+
+            return true;
+        }
+
+        static bool test(const Bytes &bytes, unsigned char c)
+        {
+            return bytes[c / 64] >> (c % 64) & 1;
+        }
+
+        static void add(Bytes &bytes, unsigned char first, unsigned char last)
+        {
+            for (unsigned c = first; c <= last; c++)
+                bytes[c / 64] |= uint64_t(1) << (c % 64);
+        }
+
+        // \d \w and \s. any other escaped byte stands for itself
+        static Bytes escape(char c)
+        {
+            Bytes bytes{};
+
+            switch (c)
+            {
+                case 'd': add(bytes, '0', '9'); break;
+                case 'w': add(bytes, '0', '9'); add(bytes, 'a', 'z'); add(bytes, 'A', 'Z'); add(bytes, '_', '_'); break;
+                case 's': add(bytes, ' ', ' '); add(bytes, '\t', '\r'); break;
+                default:  add(bytes, c, c); break;
+            }
+
+            return bytes;
+        }
+
+        // reads bracket expression items like ^a-z0-9_ up to a ] or the end of str
+        static bool parse_class(std::string_view str, size_t &pos, Bytes &bytes)
+        {
+            bool negate = pos < str.size() && str[pos] == '^';
+
+            pos += negate;
+
+            for (size_t first = pos; pos < str.size() && (str[pos] != ']' || pos == first); )
+            {
+                if (str[pos] == '\\')
+                {
+                    if (++pos == str.size())
+                        return false;
+
+                    Bytes escaped = escape(str[pos++]);
+
+                    for (size_t w = 0; w < 4; w++)
+                        bytes[w] |= escaped[w];
+
+                    continue;
+                }
+
+                unsigned char low = str[pos++];
+                unsigned char high = low;
+
+                if (pos + 1 < str.size() && str[pos] == '-' && str[pos + 1] != ']')
+                {
+                    high = str[pos + 1];
+                    pos += 2;
+
+                    if (high < low)
+                        return false;
+                }
+
+                add(bytes, low, high);
+            }
+
+            if (negate)
+            {
+                for (uint64_t &word : bytes)
+                    word = ~word;
+            }
+
+            return true;
+        }
+
+        // a Thompson NFA. a node either consumes a byte in bytes and moves to next or moves to every node in skip without consuming
+        struct Node
+        {
+            Bytes bytes{};
+            uint32_t next = UINT32_MAX;
+            std::vector<uint32_t> skip;
+        };
+
+        struct Fragment
+        {
+            uint32_t start;
+            uint32_t end;
+        };
+
+        struct Compiler
+        {
+            std::string_view pattern;
+            size_t pos = 0;
+            std::vector<Node> nodes;
+            bool ok = true;
+
+            explicit Compiler(std::string_view pattern) :
+                pattern(pattern)
+            {
+            }
+
+            uint32_t node()
+            {
+                nodes.emplace_back();
+
+                return uint32_t(nodes.size() - 1);
+            }
+
+            Fragment empty()
+            {
+                Fragment f{node(), node()};
+                nodes[f.start].skip.push_back(f.end);
+
+                return f;
+            }
+
+            // alternatives separated by |
+            Fragment alternation()
+            {
+                Fragment f = sequence();
+
+                while (ok && pos < pattern.size() && pattern[pos] == '|')
+                {
+                    pos++;
+
+                    Fragment other = sequence();
+                    Fragment both{node(), node()};
+
+                    nodes[both.start].skip = {f.start, other.start};
+                    nodes[f.end].skip.push_back(both.end);
+                    nodes[other.end].skip.push_back(both.end);
+
+                    f = both;
+                }
+
+                return f;
+            }
+
+            Fragment sequence()
+            {
+                Fragment f = empty();
+
+                while (ok && pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')')
+                {
+                    Fragment next = repeat();
+
+                    nodes[f.end].skip.push_back(next.start);
+                    f.end = next.end;
+                }
+
+                return f;
+            }
+
+            Fragment repeat()
+            {
+                Fragment f = atom();
+
+                while (ok && pos < pattern.size() && (pattern[pos] == '*' || pattern[pos] == '+' || pattern[pos] == '?'))
+                {
+                    char op = pattern[pos++];
+                    Fragment loop{node(), node()};
+
+                    nodes[loop.start].skip.push_back(f.start);
+                    nodes[f.end].skip.push_back(loop.end);
+
+                    if (op != '+')
+                        nodes[loop.start].skip.push_back(loop.end);
+
+                    if (op != '?')
+                        nodes[f.end].skip.push_back(f.start);
+
+                    f = loop;
+                }
+
+                return f;
+            }
+
+            Fragment atom()
+            {
+                Bytes bytes{};
+                char c = pattern[pos++];
+
+                switch (c)
+                {
+                    case '(':
+                    {
+                        Fragment f = alternation();
+
+                        ok = ok && pos < pattern.size() && pattern[pos++] == ')';
+
+                        return f;
+                    }
+                    case '[':
+                        ok = parse_class(pattern, pos, bytes) && pos < pattern.size() && pattern[pos++] == ']';
+                        break;
+                    case '.':
+                        bytes.fill(~uint64_t(0));
+                        break;
+                    case '\\':
+                        ok = pos < pattern.size();
+
+                        if (ok)
+                            bytes = escape(pattern[pos++]);
+
+                        break;
+                    case '*':
+                    case '+':
+                    case '?':
+                        ok = false;
+                        break;
+                    default:
+                        add(bytes, c, c);
+                        break;
+                }
+
+                Fragment f{node(), node()};
+                nodes[f.start].bytes = bytes;
+                nodes[f.start].next = f.end;
+
+                return f;
+            }
+        };
+
+        static void closure(const std::vector<Node> &nodes, std::vector<uint32_t> &set)
+        {
+            std::vector<uint8_t> seen(nodes.size());
+
+            for (uint32_t n : set)
+                seen[n] = 1;
+
+            for (size_t i = 0; i < set.size(); i++)
+            {
+                for (uint32_t next : nodes[set[i]].skip)
+                {
+                    if (!seen[next])
+                    {
+                        seen[next] = 1;
+                        set.push_back(next);
+                    }
+                }
+            }
+
+            std::sort(set.begin(), set.end());
+        }
+
+        // builds the NFA of pattern and turns it into a DFA with the subset construction
+        bool compile(std::string_view pattern)
+        {
+            Compiler compiler{pattern};
+            Fragment f = compiler.alternation();
+
+            if (!compiler.ok || compiler.pos != pattern.size())
+                return false;
+
+            // bytes outside the charset lead to the dead state
+            if (m_has_charset)
+            {
+                for (Node &node : compiler.nodes)
+                {
+                    for (size_t w = 0; w < 4; w++)
+                        node.bytes[w] &= m_charset[w];
+                }
+            }
+
+            const std::vector<Node> &nodes = compiler.nodes;
+
+            // bytes that every consuming node treats the same share a class
+            std::map<std::vector<bool>, uint32_t> classes;
+            std::vector<unsigned char> representative;
+
+            for (unsigned c = 0; c < 256; c++)
+            {
+                std::vector<bool> signature;
+
+                for (const Node &node : nodes)
+                {
+                    if (node.next != UINT32_MAX)
+                        signature.push_back(test(node.bytes, c));
+                }
+
+                auto [it, added] = classes.try_emplace(signature, uint32_t(classes.size()));
+
+                if (added)
+                    representative.push_back(c);
+
+                m_class[c] = it->second;
+            }
+
+            m_classes = uint32_t(classes.size());
+
+            std::map<std::vector<uint32_t>, uint32_t> ids;
+            std::vector<std::vector<uint32_t>> states;
+
+            auto state_of = [&](std::vector<uint32_t> set) -> uint32_t
+            {
+                auto [it, added] = ids.try_emplace(set, uint32_t(states.size()));
+
+                if (added)
+                {
+                    states.push_back(std::move(set));
+                    m_accept.push_back(std::binary_search(states.back().begin(), states.back().end(), f.end));
+                }
+
+                return it->second;
+            };
+
+            // the empty set is the dead state
+            state_of({});
+
+            std::vector<uint32_t> start{f.start};
+            closure(nodes, start);
+            m_start = state_of(start) * m_classes;
+
+            for (size_t s = 0; s < states.size(); s++)
+            {
+                if (states.size() > max_states)
+                    return false;
+
+                m_next.resize((s + 1) * m_classes);
+
+                for (uint32_t k = 0; k < m_classes; k++)
+                {
+                    std::vector<uint32_t> next;
+
+                    for (uint32_t n : states[s])
+                    {
+                        if (nodes[n].next != UINT32_MAX && test(nodes[n].bytes, representative[k]))
+                            next.push_back(nodes[n].next);
+                    }
+
+                    closure(nodes, next);
+
+                    m_next[s * m_classes + k] = state_of(std::move(next)) * m_classes;
+                }
+            }
+
+            return states.size() <= max_states;
+        }
+    };
+
+    struct Flag;
+
+    typedef Result (*FlagFn)(Flag&);
+
+    struct Flag 
+    {
+        // the name of the flag
+        std::string_view name;
+
+        // the flag description
+        std::string_view description;
+
+        // the actual data of the flag. its also the default value if set. a default of another type than the flag fails the parse.
+        FlagData data{};
+
+        // the type of the flag. by default it will be Any
+        Type type = String;
+
+        // the flag aliases
+        std::initializer_list<std::string_view> aliases;
+
+        // the function that will be called when the flag is triggered. must call Parser::call.
+        FlagFn fn = nullptr;
+
+        // the variable the flag value will be written to. can be a pointer to a struct field or set with flag::bind. must point to the type of the flag value. without a default in data the value it holds is the default, otherwise the default is written to it.
+        FlagTarget target{};
+
+        // what happens when the flag is used more than once. by default the last value is kept
+        Repeat repeat = LastWins;
+
+        // the values a Choice flag accepts. the default is the first one unless data holds another one or its position
+        std::initializer_list<std::string_view> choices;
+
+        // limits on the value of String and StringList flags
+        Check check{};
+    };
+
+    // a flag defined with FLAG_DEFINE. registrations form an intrusive list so defining a flag never allocates.
+    struct Registration
+    {
+        Flag flag;
+        Registration *next = nullptr;
+    };
+
+    // the head of the global flag registry. constant initialized so it is usable from any translation unit no matter the initialization order.
+    inline constinit Registration *registry = nullptr;
+
+    // links a registration into the global registry during static initialization
+    struct Registrar
+    {
+        explicit Registrar(Registration &registration)
+        {
+            registration.next = registry;
+            registry = &registration;
+        }
+    };
+
+    // a typed handle to the value of a flag. reading it is a single load with no lookup or variant check.
+    template <typename T>
+    class FlagRef
+    {
+    public:
+        FlagRef() = default;
+
+        explicit FlagRef(const T *value) :
+            m_value(value)
+        {
+        }
+
+        const T& operator*() const
+        {
+            return *m_value;
+        }
+
+        const T* operator->() const
+        {
+            return m_value;
+        }
+
+        // false if the handle does not point to a flag. happens when T does not match the flag type.
+        explicit operator bool() const
+        {
+            return m_value != nullptr;
+        }
+
+    private:
+        const T *m_value = nullptr;
+    };
+
+    // a lookup table of flags. keys can be aliases or the flag name and values are indices into Flags.
+    using FlagTable = std::unordered_map<std::string_view, uint32_t>;
+
+    // returned by lookup policies when a key has no flag
+    inline constexpr uint32_t npos = UINT32_MAX;
+
+    /*
+    * lookup policies map flag ids to flag indices. a policy must provide:
+
+    * void reserve(size_t keys)
+    * void add(std::string_view key, uint32_t index) which keeps the first index added for a key
+    * uint32_t index_of(std::string_view key) const which returns npos for unknown keys
+    * size_t size() const
+
+    * a policy can also split hashing from probing so parse() can prefetch the buckets of upcoming arguments:
+
+    * static uint64_t hash(std::string_view key)
+    * void prefetch(uint64_t hash) const
+    * uint32_t index_of(std::string_view key, uint64_t hash) const
+    */
+
+    // the default policy. a std::unordered_map so it can still be used as a FlagTable.
+    struct MapLookup : FlagTable
+    {
+        void add(std::string_view key, uint32_t index)
+        {
+            emplace(key, index);
+        }
+
+        uint32_t index_of(std::string_view key) const
+        {
+            auto it = find(key);
+
+            return it == end() ? npos : it->second;
+        }
+    };
+
+    // a byte trie over a set of prefixes. finds the longest one a string starts with in one pass over the string
+    class PrefixTrie
+    {
+    public:
+        PrefixTrie()
+        {
+            m_states.emplace_back();
+        }
+
+        // the first value added for a prefix keeps it
+        void add(std::string_view prefix, uint32_t value)
+        {
+            uint32_t state = 0;
+
+            for (char c : prefix)
+            {
+                uint32_t next = step(state, c);
+
+                if (next == npos)
+                {
+                    next = uint32_t(m_states.size());
+                    m_states[state].edges.emplace_back(c, next);
+                    m_states.emplace_back();
+                }
+
+                state = next;
+            }
+
+            if (m_states[state].value == npos)
+                m_states[state].value = value;
+        }
+
+        // returns the length and value of the longest added prefix of str. the length is 0 if there is none
+        std::pair<size_t, uint32_t> longest(std::string_view str) const
+        {
+            std::pair<size_t, uint32_t> match{0, npos};
+            uint32_t state = 0;
+
+            for (size_t i = 0; i < str.size(); i++)
+            {
+                state = step(state, str[i]);
+
+                if (state == npos)
+                    break;
+
+                if (m_states[state].value != npos)
+                    match = {i + 1, m_states[state].value};
+            }
+
+            return match;
+        }
+
+    private:
+        struct State
+        {
+            // most states of a few prefixes have one edge so they are scanned rather than hashed
+            std::vector<std::pair<char, uint32_t>> edges;
+            uint32_t value = npos;
+        };
+
+        std::vector<State> m_states;
+
+        uint32_t step(uint32_t state, char c) const
+        {
+            for (auto [edge, next] : m_states[state].edges)
+            {
+                if (edge == c)
+                    return next;
+            }
+
+            return npos;
+        }
+    };
+
+    /*
+    * flag names split on dots into a tree, so the flags under a namespace like db.pool can be found without scanning every name.
+
+    * segments are interned into small ids and a child is found by hashing its parent and segment id, so each segment of a lookup is constant time.
+    */
+    class NamespaceTree
+    {
+    public:
+        NamespaceTree()
+        {
+            m_nodes.emplace_back();
+        }
+
+        // adds a dotted name. the first flag added for a name keeps it
+        void add(std::string_view name, uint32_t index)
+        {
+            uint32_t node = 0;
+
+            for_each_segment(name, [&](std::string_view segment)
+            {
+                auto [it, added] = m_segments.try_emplace(segment, uint32_t(m_segments.size()));
+                auto [edge, created] = m_edges.try_emplace(key(node, it->second), uint32_t(m_nodes.size()));
+
+                if (created)
+                {
+                    m_nodes.push_back(Node{segment});
+
+                    Node &parent = m_nodes[node];
+
+                    if (parent.last_child == npos)
+                        parent.first_child = edge->second;
+                    else
+                        m_nodes[parent.last_child].next_sibling = edge->second;
+
+                    parent.last_child = edge->second;
+                }
+
+                node = edge->second;
+            });
+
+            if (m_nodes[node].flag == npos)
+                m_nodes[node].flag = index;
+        }
+
+        // returns the node of a dotted prefix or npos if no name starts with it. the empty prefix is the root
+        uint32_t find(std::string_view prefix) const
+        {
+            uint32_t node = 0;
+
+            for_each_segment(prefix, [&](std::string_view segment)
+            {
+                if (node == npos)
+                    return;
+
+                auto it = m_segments.find(segment);
+                auto edge = it == m_segments.end() ? m_edges.end() : m_edges.find(key(node, it->second));
+
+                node = edge == m_edges.end() ? npos : edge->second;
+            });
+
+            return node;
+        }
+
+        // calls fn with the flag index of a node and of every node below it, depth first
+        template <typename Fn>
+        void for_each(uint32_t node, Fn &&fn) const
+        {
+            if (m_nodes[node].flag != npos)
+                fn(m_nodes[node].flag);
+
+            for (uint32_t child = m_nodes[node].first_child; child != npos; child = m_nodes[child].next_sibling)
+                for_each(child, fn);
+        }
+
+    private:
+        struct Node
+        {
+            std::string_view segment;
+            uint32_t flag = npos;
+            uint32_t first_child = npos;
+            uint32_t last_child = npos;
+            uint32_t next_sibling = npos;
+        };
+
+        std::vector<Node> m_nodes;
+        std::unordered_map<std::string_view, uint32_t> m_segments;
+        // child node by parent node and segment id
+        std::unordered_map<uint64_t, uint32_t> m_edges;
+
+        static uint64_t key(uint32_t node, uint32_t segment)
+        {
+            return uint64_t(node) << 32 | segment;
+        }
+
+        template <typename Fn>
+        static void for_each_segment(std::string_view name, Fn &&fn)
+        {
+            while (!name.empty())
+            {
+                size_t dot = name.find('.');
+
+                fn(name.substr(0, dot));
+
+                name = dot == std::string_view::npos ? std::string_view{} : name.substr(dot + 1);
+            }
+        }
+    };
+
+    // compares every key in order. has no hashing cost but FlatLookup is as fast at about 4 keys and faster above that, so it is only worth it for the smallest schemas or to avoid building a table.
+    class LinearLookup
+    {
+    public:
+        void reserve(size_t keys)
+        {
+            m_keys.reserve(keys);
+        }
+
+        void add(std::string_view key, uint32_t index)
+        {
+            if (index_of(key) == npos)
+                m_keys.emplace_back(key, index);
+        }
+
+        uint32_t index_of(std::string_view key) const
+        {
+            for (auto &[k, index] : m_keys)
+            {
+                if (k.size() == key.size() && std::memcmp(k.data(), key.data(), key.size()) == 0)
+                    return index;
+            }
+
+            return npos;
+        }
+
+        size_t size() const
+        {
+            return m_keys.size();
+        }
+
+    private:
+        std::vector<std::pair<std::string_view, uint32_t>> m_keys;
+    };
+
+    // an open addressing table with linear probing and a hash suited to short flag ids
+    class FlatLookup
+    {
+    public:
+        /*
+        * keys of up to 16 bytes are hashed from their first and last 8 bytes with two loads.
+
+        * longer keys hash every word so ids that only differ in the middle, like dotted names, still spread out.
+        */
+        static uint64_t hash(std::string_view key)
+        {
+            const char *p = key.data();
+            size_t n = key.size();
+
+            uint64_t a = 0, b = 0;
+
+            if (n >= 8)
+            {
+                std::memcpy(&a, p, 8);
+                std::memcpy(&b, p + n - 8, 8);
+
+                for (size_t i = 8; i + 8 < n; i += 8)
+                {
+                    uint64_t w;
+                    std::memcpy(&w, p + i, 8);
+                    a = (a ^ w) * 0x9E3779B97F4A7C15;
+                }
+            }
+            else if (n >= 4)
+            {
+                uint32_t x, y;
+                std::memcpy(&x, p, 4);
+                std::memcpy(&y, p + n - 4, 4);
+                a = x;
+                b = y;
+            }
+            else if (n > 0)
+            {
+                a = uint8_t(p[0]) | uint64_t(uint8_t(p[n / 2])) << 8 | uint64_t(uint8_t(p[n - 1])) << 16;
+            }
+
+            uint64_t h = (a ^ std::rotl(b, 29) ^ n) * 0x9E3779B97F4A7C15;
+
+            return h ^ (h >> 29);
+        }
+
+        void reserve(size_t keys)
+        {
+            size_t capacity = 16;
+
+            while (capacity < keys * 2)
+                capacity *= 2;
+
+            if (capacity > m_slots.size())
+                rehash(capacity);
+        }
+
+        void add(std::string_view key, uint32_t index)
+        {
+            if ((m_size + 1) * 2 > m_slots.size())
+                rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+
+            uint64_t h = hash(key);
+            Slot *slot = probe(key, h);
+
+            if (slot->key.data())
+                return;
+
+            *slot = Slot{key, index, uint32_t(h >> 32)};
+            m_size++;
+        }
+
+        uint32_t index_of(std::string_view key) const
+        {
+            return index_of(key, hash(key));
+        }
+
+        uint32_t index_of(std::string_view key, uint64_t h) const
+        {
+            if (m_slots.empty())
+                return npos;
+
+            const Slot *slot = probe(key, h);
+
+            return slot->key.data() ? slot->index : npos;
+        }
+
+        void prefetch(uint64_t h) const
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            if (!m_slots.empty())
+                __builtin_prefetch(&m_slots[h & (m_slots.size() - 1)]);
+#endif
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+    private:
+        struct Slot
+        {
+            // a null key marks an empty slot
+            std::string_view key{};
+            uint32_t index = npos;
+            // the high half of the hash. compared before the key to skip most mismatches
+            uint32_t tag = 0;
+        };
+
+        std::vector<Slot> m_slots;
+        size_t m_size = 0;
+
+        // returns the slot holding key or the empty slot where it would go
+        Slot* probe(std::string_view key, uint64_t h) const
+        {
+            size_t mask = m_slots.size() - 1;
+            uint32_t tag = h >> 32;
+
+            for (size_t i = h & mask;; i = (i + 1) & mask)
+            {
+                const Slot &slot = m_slots[i];
+
+                if (!slot.key.data() || (slot.tag == tag && slot.key == key))
+                    return const_cast<Slot*>(&slot);
+            }
+        }
+
+        void rehash(size_t capacity)
+        {
+            std::vector<Slot> old(capacity);
+            old.swap(m_slots);
+
+            for (const Slot &slot : old)
+            {
+                if (slot.key.data())
+                    *probe(slot.key, hash(slot.key)) = slot;
+            }
+        }
+    };
+
+    // an open addressing map from keys to values with linear probing. the value of Map flags
+    class FlatMap
+    {
+    public:
+        // returns the value of key or nullptr if it is not in the map
+        const std::string_view* find(std::string_view key) const
+        {
+            if (m_slots.empty())
+                return nullptr;
+
+            const Slot *slot = probe(key, FlatLookup::hash(key));
+
+            return slot->key.data() ? &slot->value : nullptr;
+        }
+
+        bool contains(std::string_view key) const
+        {
+            return find(key) != nullptr;
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        // calls fn with every key and value. the order is not specified
+        template <typename Fn>
+        void for_each(Fn &&fn) const
+        {
+            for (const Slot &slot : m_slots)
+            {
+                if (slot.key.data())
+                    fn(slot.key, slot.value);
+            }
+        }
+
+        // adds key or replaces its value
+        void insert(std::string_view key, std::string_view value)
+        {
+            if ((m_size + 1) * 2 > m_slots.size())
+                rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+
+            uint64_t h = FlatLookup::hash(key);
+            Slot *slot = probe(key, h);
+
+            if (!slot->key.data())
+            {
+                *slot = Slot{key, value, uint32_t(h >> 32)};
+                m_size++;
+                return;
+            }
+
+            slot->value = value;
+        }
+
+    private:
+        struct Slot
+        {
+            // a null key marks an empty slot
+            std::string_view key{};
+            std::string_view value;
+            uint32_t tag = 0;
+        };
+
+        std::vector<Slot> m_slots;
+        size_t m_size = 0;
+
+        Slot* probe(std::string_view key, uint64_t h) const
+        {
+            size_t mask = m_slots.size() - 1;
+            uint32_t tag = h >> 32;
+
+            for (size_t i = h & mask;; i = (i + 1) & mask)
+            {
+                const Slot &slot = m_slots[i];
+
+                if (!slot.key.data() || (slot.tag == tag && slot.key == key))
+                    return const_cast<Slot*>(&slot);
+            }
+        }
+
+        void rehash(size_t capacity)
+        {
+            std::vector<Slot> old(capacity);
+            old.swap(m_slots);
+
+            for (const Slot &slot : old)
+            {
+                if (slot.key.data())
+                    *probe(slot.key, FlatLookup::hash(slot.key)) = slot;
+            }
+        }
+    };
+
+    // the list of flags. uses a deque instead of a vector so references given to callbacks and get() stay valid as it grows.
+    using Flags = std::deque<Flag>;
+
+    // an immutable copy of every flag value published by Parser::reload. indexed the same way as Parser::flags()
+    struct Snapshot
+    {
+        std::vector<FlagData> values;
+        // a bitset of the flags that were triggered
+        std::vector<uint64_t> triggered;
+        // keeps the storage of the parsed arguments alive as long as the snapshot, since string values point into it
+        std::shared_ptr<const void> owner;
+        // keeps the memory list values point into alive
+        std::shared_ptr<const void> arena;
+
+        const FlagData& operator[](uint32_t index) const
+        {
+            return values[index];
+        }
+    };
+
+    struct Options 
+    {
+        // the prefix used for all flag names
+        std::string_view flag_prefix = "-";
+        // the characters that will be used to separate the flag name and value
+        std::string_view separator = "=";
+        // when set to true the parse function will fail when an incorrect flag is used
+        bool strict_flags = true;
+        // the character that separates the elements of list flags
+        char list_separator = ',';
+        // when set to true and the lookup policy supports it, flag ids are looked up a window at a time with their buckets prefetched first. helps large schemas that are not in cache but costs a little on small ones.
+        bool batch_lookups = false;
+        // when set to true an id that is not a flag but is made of one letter flag names, like -abc, is read as those flags in order. the first one that takes a value uses the rest of the argument or the next one.
+        bool short_clusters = false;
+        // bool flags can also be set to false with this prefix before their name or alias, like --no-color. empty turns it off
+        std::string_view negation_prefix = "no-";
+    };
+
+    // a flag parser. Lookup is the policy used to map flag ids to flags
+    template <typename Lookup = MapLookup>
+    class BasicParser 
+    {
+    public:
+
+        using View     = std::span<char*>;
+        using Flagless = std::vector<std::string_view>;
+
+        BasicParser(View args, Options options) :
+            m_options(options),
+            m_args(args)
+        {
+        }
+
+        BasicParser& set(Flag &&flag)
+        {
+            uint32_t index = m_flags.size();
+
+            Flag &f = m_flags.emplace_back(flag);
+
+            FlagData empty = empty_value(f.type);
+
+            // a null view is the data of a flag that gave no default
+            if (auto view = std::get_if<std::string_view>(&f.data); (!view || view->data()) && !has_default(f, empty))
+            {
+                schema_error(f.name, "default does not match flag type");
+
+                f.data = empty;
+            }
+
+            if (f.target.index() != 0)
+            {
+                // the target alternatives are the data alternatives in the same order after monostate, which a static_assert keeps true
+                if (f.target.index() != empty.index() + 1)
+                    schema_error(f.name, "target type does not match flag type");
+                else if (!has_default(f, empty))
+                    std::visit([&](auto target) { load(f, target); }, f.target);
+            }
+
+            if (f.type == Choice)
+            {
+                const Choices &choices = m_choices.emplace(index, make_choices(f.choices)).first->second;
+
+                // a default given by name is stored as its position. a null view is the default data of a flag that gave none
+                if (auto name = std::get_if<std::string_view>(&f.data); name && name->data())
+                {
+                    uint32_t choice = choices.find(*name);
+
+                    if (choice == npos)
+                        schema_error(f.name, "default is not one of the choices");
+
+                    f.data = uint64_t(choice == npos ? 0 : choice);
+                }
+                else if (auto position = std::get_if<uint64_t>(&f.data); position && *position >= choices.names.size() && !choices.names.empty())
+                {
+                    schema_error(f.name, "default is not one of the choices");
+
+                    f.data = uint64_t(0);
+                }
+            }
+
+            // the stored alternative always matches the type so handles into data stay valid as values are set
+            if (f.data.index() != empty.index())
+                f.data = empty;
+
+            m_types.push_back(f.type);
+            m_repeats.push_back(f.repeat);
+            m_defaults.push_back(f.data);
+            m_data.push_back(f.data);
+
+            // the target holds the default until the flag is given, as it does after reset
+            std::visit([&](auto value) { store(f, value); }, f.data);
+
+            if (index % 64 == 0)
+                m_triggered.push_back(0);
+
+            add_key(f.name, index);
+
+            for (auto alias : f.aliases)
+                add_key(alias, index);
+
+            m_namespaces.add(f.name, index);
+
+            const Check &check = f.check;
+
+            if ((f.type == String || f.type == StringList) && (check.min_length > 0 || check.max_length != SIZE_MAX || !check.charset.empty() || !check.pattern.empty()))
+                m_validators.emplace(index, Validator(check));
+
+            if (f.type == Bool && !m_options.negation_prefix.empty())
+            {
+                add_negated(f.name, index);
+
+                for (auto alias : f.aliases)
+                    add_negated(alias, index);
+            }
+
+            if (f.type == Map)
+            {
+                add_map_prefix(f.name, index);
+
+                for (auto alias : f.aliases)
+                    add_map_prefix(alias, index);
+            }
+
+            return *this;
+        }
+
+        // sets every flag defined with FLAG_DEFINE. the lookup table is sized once for all of them before they are added.
+        BasicParser& set_registered()
+        {
+            std::vector<Registration*> nodes;
+            size_t keys = m_table.size();
+
+            for (Registration *node = registry; node; node = node->next)
+            {
+                nodes.push_back(node);
+                keys += 1 + node->flag.aliases.size();
+            }
+
+            m_table.reserve(keys);
+            m_types.reserve(m_types.size() + nodes.size());
+            m_repeats.reserve(m_repeats.size() + nodes.size());
+            m_defaults.reserve(m_defaults.size() + nodes.size());
+            m_data.reserve(m_data.size() + nodes.size());
+
+            // the registry is built front to back so walk it backwards to keep definition order
+            for (auto it = nodes.rbegin(); it != nodes.rend(); ++it)
+                set(Flag((*it)->flag));
+
+            return *this;
+        }
+
+        // sets a flag and gives back a typed handle to its value. T must be std::string_view, double or bool to match the flag type.
+        template <typename T>
+        BasicParser& set(Flag &&flag, FlagRef<T> &ref)
+        {
+            set(std::move(flag));
+
+            ref = FlagRef<T>(std::get_if<T>(&m_flags.back().data));
+
+            return *this;
+        }
+
+        Result parse()
+        {
+            m_flagless.reserve(m_args.size());
+
+            return parse([this](std::string_view arg) { m_flagless.push_back(arg); });
+        }
+
+        /*
+        * parses the arguments and passes each one that is not a flag to visit as soon as it is found.
+
+        * nothing is stored in args() so memory use does not grow with the number of arguments.
+        */
+        template <typename Visit>
+        Result parse(Visit &&visit)
+        {
+            // flag indices of a window of upcoming arguments. they are looked up together so their cache misses overlap
+            uint32_t window[lookahead];
+            size_t window_start = 0;
+            size_t window_end = 0;
+
+            start();
+
+            for (size_t a = 0; a < m_args.size(); a++)
+            {
+                const uint32_t *resolved = nullptr;
+
+                if constexpr (pipelined)
+                {
+                    if (m_options.batch_lookups)
+                    {
+                        if (a >= window_end)
+                        {
+                            window_start = a;
+                            window_end = std::min(a + lookahead, m_args.size());
+
+                            lookup_window(window_start, window_end, window);
+                        }
+
+                        resolved = &window[a - window_start];
+                    }
+                }
+
+                Result result = step(m_args[a], resolved, m_pending, visit, nullptr);
+
+                if (!result.ok)
+                    return result;
+            }
+
+            return finish();
+        }
+
+        /*
+        * parses a single argument. a stream of feed calls followed by finish gives the same result as parse.
+
+        * a flag without an inline value waits for the next token, so each call does a constant amount of work.
+
+        * views into token are kept as flag values and arguments so it must outlive them. flags and their targets get the values of a stream when finish is called.
+        */
+        Result feed(std::string_view token)
+        {
+            return feed(token, [this](std::string_view arg) { m_flagless.push_back(arg); });
+        }
+
+        // parses a single argument. passes it to visit instead of storing it in args() if it is not a flag
+        template <typename Visit>
+        Result feed(std::string_view token, Visit &&visit)
+        {
+            // the first token after finish begins a new parse
+            if (!m_parsing)
+                start();
+
+            Result result = step(token, nullptr, m_pending, visit, nullptr);
+
+            // the rest of a stream that failed is dropped so it can not leak into the next one
+            if (!result.ok)
+                begin();
+
+            return result;
+        }
+
+        /*
+        * drops a stream of feed calls that was not finished, like a line given up on in a shell, so the next token starts a new one.
+
+        * a flag waiting for its value and every value the stream gave are dropped, since values only reach flags and their targets in finish.
+        */
+        void begin()
+        {
+            start();
+        }
+
+        // ends a stream of feed calls. fails if the last flag is still waiting for its value, a constraint is broken or a flag was set with a bad schema.
+        Result finish()
+        {
+            Result result = check_parse();
+
+            // a parse that fails leaves every flag as it was
+            if (!result.ok)
+                drop();
+
+            group_values();
+            group_lists();
+
+            if (m_last_arena)
+                carry_sets();
+
+            if (result.ok)
+                publish();
+
+            m_last_arena.reset();
+            m_parsing = false;
+            clear_buffers();
+
+            return result;
+        }
+
+        // makes parsing fail if id is set without every flag in ids. the ids are looked up on the next parse so flags can be set later
+        BasicParser& require(std::string_view id, std::initializer_list<std::string_view> ids)
+        {
+            return constrain(Constraint::Requires, id, ids, {});
+        }
+
+        // makes parsing fail if id is set together with any flag in ids
+        BasicParser& conflict(std::string_view id, std::initializer_list<std::string_view> ids)
+        {
+            return constrain(Constraint::Conflicts, id, ids, {});
+        }
+
+        // makes parsing fail unless the number of flags in ids that are set follows rule
+        BasicParser& group(std::initializer_list<std::string_view> ids, GroupRule rule)
+        {
+            return constrain(Constraint::Group, {}, ids, rule);
+        }
+
+        /*
+        * parses the arguments on several threads. gives the same result as parse, including the first error.
+
+        * the arguments are split into chunks that never start on a value of a flag in the previous chunk. each thread finds the flags and arguments in its chunk, then values are set in argument order so the last occurrence of a flag still wins.
+        */
+        Result parse_parallel(size_t threads = std::thread::hardware_concurrency())
+        {
+            // below this many arguments per thread starting threads costs more than it saves
+            constexpr size_t min_chunk = 4096;
+
+            threads = std::min(threads, m_args.size() / min_chunk);
+
+            if (threads < 2)
+                return parse();
+
+            start();
+
+            std::vector<size_t> bounds{0};
+
+            for (size_t t = 1; t < threads; t++)
+            {
+                size_t b = std::max(bounds.back(), m_args.size() * t / threads);
+
+                while (b < m_args.size() && takes_value(m_args[b-1]))
+                    b++;
+
+                bounds.push_back(b);
+            }
+
+            bounds.push_back(m_args.size());
+
+            std::vector<Chunk> chunks(threads);
+            std::vector<std::thread> workers;
+
+            for (size_t t = 0; t < threads; t++)
+            {
+                workers.emplace_back([this, &chunks, &bounds, t]
+                {
+                    Chunk &chunk = chunks[t];
+                    Pending pending;
+
+                    auto visit = [&](std::string_view arg) { chunk.positionals.push_back(arg); };
+
+                    for (size_t a = bounds[t]; a < bounds[t+1] && chunk.error.ok; a++)
+                        chunk.error = step(m_args[a], nullptr, pending, visit, &chunk);
+
+                    if (chunk.error.ok && pending.index != npos)
+                        chunk.error = Result{false, pending.id, "could not set flag value"};
+                });
+            }
+
+            for (std::thread &worker : workers)
+                worker.join();
+
+            m_flagless.reserve(m_flagless.size() + m_args.size());
+
+            for (Chunk &chunk : chunks)
+            {
+                size_t done = 0;
+
+                for (const Event &event : chunk.events)
+                {
+                    m_flagless.insert(m_flagless.end(), chunk.positionals.begin() + done, chunk.positionals.begin() + event.positionals);
+                    done = event.positionals;
+
+                    Result result = set_value(event.value, event.index, event.id);
+
+                    if (!result.ok)
+                        return result;
+                }
+
+                m_flagless.insert(m_flagless.end(), chunk.positionals.begin() + done, chunk.positionals.end());
+
+                if (!chunk.error.ok)
+                    return chunk.error;
+            }
+
+            return finish();
+        }
+
+#ifdef FLAG_HAS_POSIX
+        /*
+        * parses NUL separated arguments read from a file descriptor, like the output of find -print0.
+
+        * regular files are mapped into memory. anything else is read chunk_size bytes at a time, with a buffer that only grows past that for a single longer argument.
+
+        * arguments that are not flags are passed to visit and are only valid during the call. flags and their values are copied so flag data stays valid.
+        */
+        template <typename Visit>
+        Result parse_fd(int fd, Visit &&visit, size_t chunk_size = 1 << 16)
+        {
+            start();
+
+            struct stat info;
+
+            if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+            {
+                size_t size = info.st_size;
+                void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (data != MAP_FAILED)
+                {
+                    madvise(data, size, MADV_SEQUENTIAL);
+
+                    // the mapping lives as long as the parser since flag values point into it
+                    const char *pos = static_cast<const char*>(data);
+                    const char *end = pos + size;
+
+                    m_mappings.emplace_back(pos, [size](const char *p) { munmap(const_cast<char*>(p), size); });
+
+                    Result result = parse_records(pos, end, visit, false);
+
+                    if (result.ok && pos < end)
+                        result = record({pos, size_t(end - pos)}, visit, false);
+
+                    return result.ok ? finish() : result;
+                }
+            }
+
+            std::vector<char> buffer(std::max<size_t>(chunk_size, 1));
+            // the bytes of an argument that was cut off at the end of the last chunk. moved to the front of the buffer
+            size_t carried = 0;
+
+            for (;;)
+            {
+                if (carried == buffer.size())
+                    buffer.resize(buffer.size() * 2);
+
+                ssize_t n = read(fd, buffer.data() + carried, buffer.size() - carried);
+
+                if (n < 0 && errno == EINTR)
+                    continue;
+
+                if (n < 0)
+                    return Result{false, {}, "could not read arguments"};
+
+                if (n == 0)
+                    break;
+
+                const char *pos = buffer.data();
+                const char *end = pos + carried + n;
+
+                Result result = parse_records(pos, end, visit, true);
+
+                if (!result.ok)
+                    return result;
+
+                carried = end - pos;
+                std::memmove(buffer.data(), pos, carried);
+            }
+
+            // the last argument does not need a terminator
+            if (carried)
+            {
+                Result result = record({buffer.data(), carried}, visit, true);
+
+                if (!result.ok)
+                    return result;
+            }
+
+            return finish();
+        }
+#endif
+
+        /*
+        * resets every flag to its default value then parses args and publishes the new values as a snapshot.
+
+        * readers on other threads should only read values through snapshot(). the old snapshot stays valid for as long as a reader holds it.
+
+        * owner is kept alive by the snapshot and should own the memory args point into.
+
+        * reloads must not run concurrently with each other. on failure the previous snapshot stays published and the parser is put back the way it was, so nothing points into the memory of owner.
+        */
+        Result reload(View args, std::shared_ptr<const void> owner = {})
+        {
+            // the values of the parser before the reload, put back if it fails
+            std::vector<FlagData> values = m_data;
+
+            std::vector<uint64_t> triggered = m_triggered;
+            std::shared_ptr<Arena> arena = m_arena;
+            std::shared_ptr<Arena> last_arena = m_last_arena;
+            bool parsing = m_parsing;
+            View old_args = m_args;
+            Flagless flagless;
+            std::vector<FlagData> accumulated;
+            std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+            flagless.swap(m_flagless);
+            accumulated.swap(m_values);
+            ranges.swap(m_ranges);
+
+            reset();
+
+            m_args = args;
+
+            Result result = parse();
+
+            if (!result.ok)
+            {
+                for (size_t i = 0; i < m_flags.size(); i++)
+                    std::visit([&](auto value) { store(i, value); }, values[i]);
+
+                m_triggered = std::move(triggered);
+                m_arena = std::move(arena);
+                m_last_arena = std::move(last_arena);
+                m_parsing = parsing;
+                m_args = old_args;
+                m_flagless.swap(flagless);
+                m_values.swap(accumulated);
+                m_ranges.swap(ranges);
+                m_pending = {};
+                clear_buffers();
+
+                return result;
+            }
+
+            Snapshot next;
+            next.values = m_data;
+
+            next.triggered = m_triggered;
+            next.owner = std::move(owner);
+            next.arena = m_arena;
+
+            m_snapshot->store(std::make_shared<const Snapshot>(std::move(next)), std::memory_order_release);
+
+            return result;
+        }
+
+        /*
+        * returns the last snapshot published by reload. will be null if reload was never called.
+
+        * std::atomic<std::shared_ptr> takes a short lock inside common standard libraries, so loading a snapshot is safe from any thread but not lock free or wait free.
+        */
+        std::shared_ptr<const Snapshot> snapshot() const
+        {
+            return m_snapshot->load(std::memory_order_acquire);
+        }
+
+        // calls all flag functions. returns the first result that has an error.
+        Result call()
+        {
+            for (size_t w = 0; w < m_triggered.size(); w++)
+            {
+                for (uint64_t bits = m_triggered[w]; bits; bits &= bits - 1)
+                {
+                    Flag &flag = m_flags[w * 64 + std::countr_zero(bits)];
+
+                    if (!flag.fn)
+                        continue;
+
+                    Result result = (*flag.fn)(flag);
+
+                    if (!result.ok)
+                        return result;
+                }
+            }
+
+            return {};
+        }
+
+        /*
+        * returns an array of flags
+
+        * this is where the actual data is stored
+        */
+        Flags& flags()
+        {
+            return m_flags;
+        }
+
+        /* 
+        * returns a lookup table for flags
+
+        * both aliases and flag names can be used to lookup a flag
+
+        * flag is returned as an index into flags()
+        */
+        Lookup& table()
+        {
+            return m_table;
+        }
+
+        // a shorthand for looking up flags by alias or name. checks to see if the flag is valid beforehand and returns an optional to the flag pointer.
+        std::optional<Flag*> get(std::string_view id)
+        {
+            uint32_t index = lookup(id);
+
+            if (index == npos)
+                return {};
+
+            return { &m_flags[index] };
+        }
+
+        std::optional<const Flag*> get(std::string_view id) const
+        {
+            uint32_t index = lookup(id);
+
+            if (index == npos)
+                return {};
+
+            return { &m_flags[index] };
+        }
+
+        // returns a typed handle to the value of a flag. the handle is empty if the flag does not exist or T does not match its type.
+        template <typename T>
+        FlagRef<T> ref(std::string_view id) const
+        {
+            uint32_t index = lookup(id);
+
+            if (index == npos)
+                return {};
+
+            return FlagRef<T>(std::get_if<T>(&m_flags[index].data));
+        }
+
+        // returns the index of a flag by alias or name. can be used to read values from a Snapshot.
+        std::optional<uint32_t> index(std::string_view id) const
+        {
+            uint32_t index = lookup(id);
+
+            if (index == npos)
+                return {};
+
+            return { index };
+        }
+
+        /*
+        * returns every value a flag was given in argument order if it accumulates values.
+
+        * for other flags, including list, Ranges, Map and Count flags which hold every value already, it is the current value if the flag was triggered. the span is valid until the next parse.
+        */
+        std::span<const FlagData> values(std::string_view id) const
+        {
+            uint32_t index = lookup(id);
+
+            if (index == npos || !is_triggered(index))
+                return {};
+
+            if (m_repeats[index] != Accumulate || appends(m_types[index]))
+                return {&m_flags[index].data, 1};
+
+            // values are only grouped by finish
+            if (index >= m_ranges.size())
+                return {};
+
+            auto [offset, count] = m_ranges[index];
+
+            return {m_values.data() + offset, count};
+        }
+
+        // returns true if the flag was set by the last parse
+        bool triggered(std::string_view id) const
+        {
+            uint32_t index = lookup(id);
+
+            return index != npos && is_triggered(index);
+        }
+
+        std::string to_string() const 
+        {
+            std::string output;
+
+            for (const Flag &flag : m_flags)
+                append_help(output, flag);
+
+            return output;
+        }
+
+        // the help of every flag under a dotted namespace like db.pool. the cost depends on the number of flags under it, not the schema size
+        std::string to_string(std::string_view prefix) const
+        {
+            std::string output;
+
+            for_each_under(prefix, [&](const Flag &flag) { append_help(output, flag); });
+
+            return output;
+        }
+
+        // calls fn with every flag whose name is prefix or starts with prefix and a dot. flags are grouped by namespace, each level in the order it was first seen
+        template <typename Fn>
+        void for_each_under(std::string_view prefix, Fn &&fn) const
+        {
+            uint32_t node = m_namespaces.find(prefix);
+
+            if (node != npos)
+                m_namespaces.for_each(node, [&](uint32_t index) { fn(m_flags[index]); });
+        }
+
+        // returns the arguments without flags
+        Flagless& args()
+        {
+            return m_flagless;
+        }
+
+        Options& options()
+        {
+            return m_options;
+        }
+
+    private:
+        // how many arguments ahead of the current one are hashed and prefetched
+        static constexpr size_t lookahead = 8;
+
+        // whether the lookup policy can split hashing from probing
+        static constexpr bool pipelined = requires(const Lookup &table, std::string_view key, uint64_t h)
+        {
+            Lookup::hash(key);
+            table.prefetch(h);
+            table.index_of(key, h);
+        };
+
+        // every flag. names, descriptions and the rest of the schema are only read by set and help, and values are written here once per parse by publish
+        Flags m_flags;
+        Lookup m_table;
+        // copies of the type and repeat of each flag so finding how to handle an id does not read its node. indexed by flag index
+        std::vector<Type> m_types;
+        std::vector<Repeat> m_repeats;
+        // a bitset of the flags that have been triggered
+        std::vector<uint64_t> m_triggered;
+        // a flag that is waiting for the next argument to be its value
+        struct Pending
+        {
+            uint32_t index = npos;
+            std::string_view id;
+        };
+
+        // a flag occurrence found by a parse_parallel thread. applied in argument order once all threads finish
+        struct Event
+        {
+            uint32_t index;
+            std::string_view id;
+            std::string_view value;
+            // how many positional arguments of the chunk came before it
+            size_t positionals;
+        };
+
+        // what a parse_parallel thread found in its chunk of arguments
+        struct Chunk
+        {
+            std::vector<Event> events;
+            Flagless positionals;
+            Result error;
+        };
+
+        Pending m_pending;
+#ifdef FLAG_HAS_POSIX
+        // files mapped by parse_fd. unmapped when the parser is destroyed
+        std::vector<std::shared_ptr<const char>> m_mappings;
+#endif
+        // copies of arguments read by parse_fd that flag data points to
+        std::deque<std::string> m_owned;
+        // every value given to an accumulating flag in argument order
+        std::vector<std::pair<uint32_t, FlagData>> m_occurrences;
+        // the values in m_occurrences grouped by flag so each flag has a contiguous span. filled in by finish
+        std::vector<FlagData> m_values;
+        // the offset and count of each flag in m_values
+        std::vector<std::pair<uint32_t, uint32_t>> m_ranges;
+        // a run of list elements from one use of a list flag
+        struct Run
+        {
+            uint32_t index;
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        // memory that flag data points into. reload hands it to the published snapshot and starts a new one
+        struct Arena
+        {
+            // the elements of every list flag grouped by flag
+            std::vector<std::string_view> strings;
+            std::vector<double> numbers;
+            std::vector<float, AlignedAllocator<float>> floats;
+            // the sets of Ranges flags and maps of Map flags. deques so flag data pointing to them stays valid
+            std::deque<RangeSet> range_sets;
+            std::deque<FlatMap> maps;
+
+            bool empty() const
+            {
+                return strings.empty() && numbers.empty() && floats.empty() && range_sets.empty() && maps.empty();
+            }
+        };
+
+        std::shared_ptr<Arena> m_arena = std::make_shared<Arena>();
+        // the arena of the last parse while a new one runs. finish copies out the values of flags that were not given again and lets it go
+        std::shared_ptr<Arena> m_last_arena;
+        // true from the start of a parse or stream until finish
+        bool m_parsing = false;
+        // list elements in argument order. grouped into the arena by finish
+        std::vector<std::string_view> m_list_strings;
+        std::vector<double> m_list_numbers;
+        std::vector<float> m_list_floats;
+        std::vector<Run> m_runs;
+        // the values of a Choice flag with a perfect hash over them
+        struct Choices
+        {
+            std::vector<std::string_view> names;
+            // the position of the name in each slot plus one. 0 marks an empty slot. empty if no perfect hash was found and names are compared in order
+            std::vector<uint32_t> slots;
+            uint64_t seed = 0;
+            // the error for a value that is not one of the names. lists the names
+            std::string error;
+
+            // returns the position of name or npos if it is not a choice
+            uint32_t find(std::string_view name) const
+            {
+                if (slots.empty())
+                {
+                    auto it = std::find(names.begin(), names.end(), name);
+
+                    return it == names.end() ? npos : uint32_t(it - names.begin());
+                }
+
+                uint32_t slot = slots[mix(FlatLookup::hash(name), seed) & (slots.size() - 1)];
+
+                return slot && names[slot - 1] == name ? slot - 1 : npos;
+            }
+
+            static uint64_t mix(uint64_t hash, uint64_t seed)
+            {
+                uint64_t h = (hash ^ seed) * 0x9E3779B97F4A7C15;
+
+                return h ^ (h >> 32);
+            }
+        };
+
+        // a rule between flags checked after parsing
+        struct Constraint
+        {
+            enum Kind : uint8_t
+            {
+                Requires,
+                Conflicts,
+                Group
+            };
+
+            Kind kind;
+            GroupRule rule;
+            // the flag the rule applies to. unused by groups
+            std::string_view id;
+            uint32_t index = npos;
+            std::vector<std::string_view> ids;
+            // the bits of the flags in ids as (word, bits) pairs over the triggered bitset. only words with a bit set are kept
+            std::vector<std::pair<uint32_t, uint64_t>> mask;
+            std::string error;
+        };
+
+        // a deque so the error of a returned Result stays valid when constraints are added
+        std::deque<Constraint> m_constraints;
+        // constraints before this one have their ids looked up and masks built
+        size_t m_compiled = 0;
+        // flag names by dotted namespace
+        NamespaceTree m_namespaces;
+        // set in the flag index of a negated bool id like no-x as it is passed from lookup_key to step. never stored in m_table
+        static constexpr uint32_t negated = uint32_t(1) << 31;
+        // the names of negated bool ids
+        std::deque<std::string> m_negations;
+        // negated bool ids. kept apart from m_table so they never hide a real key and table() only holds flag indices
+        Lookup m_negated_table;
+        // the flag index of every one letter name or alias. npos for letters without a flag
+        std::array<uint32_t, 256> m_short = make_short();
+        // the compiled checks of String and StringList flags by flag index
+        std::unordered_map<uint32_t, Validator> m_validators;
+        // the first mistake found by set() in a flag definition. set() cannot fail so it is returned by every parse
+        Result m_schema_error;
+        // the choices of every Choice flag by flag index
+        std::unordered_map<uint32_t, Choices> m_choices;
+        // the names and aliases of Map flags with their flag index, without the * of flag families. matched against ids that are not in the table
+        PrefixTrie m_map_prefixes;
+        // the values flags had when they were set. used to reset flags before a reload
+        std::vector<FlagData> m_defaults;
+        // the value of every flag while parsing so setting one never touches its Flag. finish writes the values of the flags it was given to their Flag and target
+        std::vector<FlagData> m_data;
+        // behind a pointer since atomics can not be moved and the parser should be
+        std::unique_ptr<std::atomic<std::shared_ptr<const Snapshot>>> m_snapshot = std::make_unique<std::atomic<std::shared_ptr<const Snapshot>>>();
+        Options m_options;
+        View m_args;
+        Flagless m_flagless;
+
+        // adds a name or alias to the table. one letter keys also go in m_short. like the table the first flag added for a key keeps it
+        void add_key(std::string_view key, uint32_t index)
+        {
+            m_table.add(key, index);
+
+            if (key.size() == 1 && m_short[uint8_t(key[0])] == npos)
+                m_short[uint8_t(key[0])] = index;
+        }
+
+        const Validator* find_validator(uint32_t index) const
+        {
+            if (m_validators.empty())
+                return nullptr;
+
+            auto it = m_validators.find(index);
+
+            return it == m_validators.end() ? nullptr : &it->second;
+        }
+
+        void append_help(std::string &output, const Flag &flag) const
+        {
+            output += m_options.flag_prefix;
+            output += flag.name;
+            output += "\t\t";
+            output += flag.description;
+            output += "\n";
+        }
+
+        // adds the negated form of a bool flag key to m_negated_table. the name is owned by the parser
+        void add_negated(std::string_view key, uint32_t index)
+        {
+            std::string &name = m_negations.emplace_back(m_options.negation_prefix);
+            name += key;
+
+            m_negated_table.add(name, index);
+        }
+
+        // returns the flag index of an id. negated bool ids have the polarity bit set. one letter ids are a single array load
+        uint32_t lookup_key(std::string_view id) const
+        {
+            if (id.size() == 1)
+                return m_short[uint8_t(id[0])];
+
+            uint32_t index = m_table.index_of(id);
+
+            return index == npos ? lookup_negated(id) : index;
+        }
+
+        // real keys are looked up first so a negated id is only searched for when the id is not a flag
+        uint32_t lookup_negated(std::string_view id) const
+        {
+            if (m_negated_table.size() == 0)
+                return npos;
+
+            uint32_t index = m_negated_table.index_of(id);
+
+            return index == npos ? npos : index | negated;
+        }
+
+        // returns the flag index of an id. --no-x gives the index of x
+        uint32_t lookup(std::string_view id) const
+        {
+            uint32_t entry = lookup_key(id);
+
+            return entry == npos ? npos : entry & ~negated;
+        }
+
+        /*
+        * reads an explicit bool value: true, false, yes, no, 1 or 0 in any case.
+
+        * the value is packed into an integer with letters lowered so it is matched by one switch instead of string compares.
+        */
+        static bool parse_bool(std::string_view str, bool &value)
+        {
+            constexpr auto pack = [](std::string_view s)
+            {
+                uint64_t word = 0;
+
+                for (size_t i = 0; i < s.size(); i++)
+                    word |= uint64_t(uint8_t(s[i]) | 0x20) << (i * 8);
+
+                return word;
+            };
+
+            if (str.empty() || str.size() > 5)
+                return false;
+
+            switch (pack(str))
+            {
+                case pack("true"):
+                case pack("yes"):
+                case pack("1"):
+                    value = true;
+                    return true;
+                case pack("false"):
+                case pack("no"):
+                case pack("0"):
+                    value = false;
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // bool and count flags are set by their name alone and never take a value
+        static bool is_switch(Type type)
+        {
+            return type == Bool || type == Count;
+        }
+
+        // returns how many letters of id are read as a cluster of one letter flags, up to and including the first flag that takes a value. 0 if id is not a cluster
+        size_t cluster_length(std::string_view id) const
+        {
+            if (!m_options.short_clusters || id.size() < 2)
+                return 0;
+
+            for (size_t i = 0; i < id.size(); i++)
+            {
+                uint32_t index = m_short[uint8_t(id[i])];
+
+                if (index == npos)
+                    return 0;
+
+                if (!is_switch(m_types[index]))
+                    return i + 1;
+            }
+
+            return id.size();
+        }
+
+        // the value given to the last flag of a cluster: the rest of the argument without a leading separator
+        std::string_view cluster_value(std::string_view arg, size_t offset) const
+        {
+            std::string_view rest = arg.substr(offset);
+
+            if (rest.starts_with(m_options.separator))
+                rest.remove_prefix(m_options.separator.size());
+
+            return rest;
+        }
+
+        // handles the flags of a cluster like -abc. a flag that takes a value uses the rest of the argument or waits for the next one
+        Result step_cluster(std::string_view arg, size_t prefix_end, size_t length, Pending &pending, Chunk *chunk)
+        {
+            for (size_t i = 0; i < length; i++)
+            {
+                uint32_t index = m_short[uint8_t(arg[prefix_end + i])];
+                std::string_view id = arg.substr(prefix_end + i, 1);
+
+                if (is_switch(m_types[index]))
+                {
+                    // only the last flag of the cluster can be given a value, like -xv=false
+                    std::string_view value = i + 1 == length ? cluster_value(arg, prefix_end + length) : std::string_view{};
+
+                    if (Result result = apply(index, id, value, chunk); !result.ok)
+                        return result;
+
+                    continue;
+                }
+
+                std::string_view value = cluster_value(arg, prefix_end + i + 1);
+
+                if (!value.empty())
+                    return apply(index, id, value, chunk);
+
+                pending = {index, id};
+            }
+
+            return {};
+        }
+
+        BasicParser& constrain(typename Constraint::Kind kind, std::string_view id, std::initializer_list<std::string_view> ids, GroupRule rule)
+        {
+            m_constraints.push_back(Constraint{kind, rule, id, npos, ids, {}, {}});
+
+            return *this;
+        }
+
+        // looks up the ids of constraints added since the last parse and turns them into masks and error messages
+        Result compile_constraints()
+        {
+            for (; m_compiled < m_constraints.size(); m_compiled++)
+            {
+                Constraint &c = m_constraints[m_compiled];
+
+                if (c.kind != Constraint::Group && (c.index = lookup(c.id)) == npos)
+                    return Result{false, c.id, "unknown flag in constraint"};
+
+                std::string names;
+
+                for (std::string_view id : c.ids)
+                {
+                    uint32_t index = lookup(id);
+
+                    if (index == npos)
+                        return Result{false, id, "unknown flag in constraint"};
+
+                    uint32_t word = index / 64;
+                    auto it = std::find_if(c.mask.begin(), c.mask.end(), [&](auto &m) { return m.first == word; });
+
+                    if (it == c.mask.end())
+                        it = c.mask.insert(c.mask.end(), {word, 0});
+
+                    it->second |= uint64_t(1) << (index % 64);
+
+                    names += names.empty() ? "" : ", ";
+                    names += m_options.flag_prefix;
+                    names += m_flags[index].name;
+                }
+
+                if (c.kind == Constraint::Requires)
+                    c.error = "requires " + names;
+                else if (c.kind == Constraint::Conflicts)
+                    c.error = "cannot be used with " + names;
+                else if (c.rule == ExactlyOne)
+                    c.error = "exactly one of " + names + " must be set";
+                else if (c.rule == AtMostOne)
+                    c.error = "at most one of " + names + " can be set";
+                else
+                    c.error = "at least one of " + names + " must be set";
+            }
+
+            return {};
+        }
+
+        // checks every constraint against the triggered bitset with a few word wide operations each
+        Result check_constraints()
+        {
+            if (m_constraints.empty())
+                return {};
+
+            if (Result result = compile_constraints(); !result.ok)
+                return result;
+
+            for (const Constraint &c : m_constraints)
+            {
+                if (c.kind != Constraint::Group)
+                {
+                    if (!is_triggered(c.index))
+                        continue;
+
+                    bool broken = false;
+
+                    for (auto [word, bits] : c.mask)
+                        broken |= c.kind == Constraint::Requires ? (m_triggered[word] & bits) != bits : (m_triggered[word] & bits) != 0;
+
+                    if (broken)
+                        return Result{false, c.id, c.error};
+
+                    continue;
+                }
+
+                int set = 0;
+
+                for (auto [word, bits] : c.mask)
+                    set += std::popcount(m_triggered[word] & bits);
+
+                if ((c.rule == ExactlyOne && set != 1) || (c.rule == AtMostOne && set > 1) || (c.rule == AtLeastOne && set < 1))
+                    return Result{false, c.ids.empty() ? std::string_view{} : c.ids.front(), c.error};
+            }
+
+            return {};
+        }
+
+        static std::array<uint32_t, 256> make_short()
+        {
+            std::array<uint32_t, 256> table;
+            table.fill(npos);
+
+            return table;
+        }
+
+        void schema_error(std::string_view id, std::string_view error)
+        {
+            if (m_schema_error.ok)
+                m_schema_error = Result{false, id, error};
+        }
+
+        /*
+        * builds a perfect hash over the choices of a flag. choices are copied out since the initializer list does not outlive the flag.
+
+        * seeds are tried until every name lands in its own slot. the table starts at the next power of two and doubles a few times if no seed works, so it stays small.
+
+        * names whose hashes are equal can never be split by a seed. if no seed works the table is left empty and find compares names instead.
+        */
+        static Choices make_choices(std::initializer_list<std::string_view> list)
+        {
+            Choices choices;
+            std::vector<uint64_t> hashes;
+
+            choices.error = "invalid value, expected one of:";
+
+            for (std::string_view name : list)
+            {
+                if (std::find(choices.names.begin(), choices.names.end(), name) != choices.names.end())
+                    continue;
+
+                choices.names.push_back(name);
+                hashes.push_back(FlatLookup::hash(name));
+
+                choices.error += choices.names.size() == 1 ? " " : ", ";
+                choices.error += name;
+            }
+
+            size_t first_size = std::bit_ceil(std::max<size_t>(choices.names.size(), 1));
+
+            for (size_t size = first_size; size <= first_size * 8; size *= 2)
+            {
+                for (uint64_t seed = 0; seed < 64; seed++)
+                {
+                    choices.slots.assign(size, 0);
+
+                    bool unique = true;
+
+                    for (size_t i = 0; i < hashes.size() && unique; i++)
+                    {
+                        uint32_t &slot = choices.slots[Choices::mix(hashes[i], seed) & (size - 1)];
+
+                        unique = slot == 0;
+                        slot = uint32_t(i + 1);
+                    }
+
+                    if (unique)
+                    {
+                        choices.seed = seed;
+                        return choices;
+                    }
+                }
+            }
+
+            choices.slots.clear();
+
+            return choices;
+        }
+
+        // returns the length and flag index of the longest Map flag name that id starts with. the length is 0 if there is none
+        std::pair<size_t, uint32_t> match_map(std::string_view id) const
+        {
+            return m_map_prefixes.longest(id);
+        }
+
+        // a Map flag named limit-* is the family of ids starting with limit-
+        void add_map_prefix(std::string_view name, uint32_t index)
+        {
+            if (name.ends_with('*'))
+                name.remove_suffix(1);
+
+            m_map_prefixes.add(name, index);
+        }
+
+        void reset()
+        {
+            for (size_t i = 0; i < m_flags.size(); i++)
+                std::visit([&](auto value) { store(i, value); }, m_defaults[i]);
+
+            std::fill(m_triggered.begin(), m_triggered.end(), 0);
+            m_flagless.clear();
+            m_pending = {};
+            m_values.clear();
+            m_ranges.clear();
+            clear_buffers();
+            m_arena = std::make_shared<Arena>();
+            m_last_arena.reset();
+            m_parsing = false;
+        }
+
+        /*
+        * begins a parse. every parse sets the flags it is given as if for the first time and the others keep their values.
+
+        * a parse that failed before finish can leave a pending flag and values that were never grouped, which are dropped.
+        */
+        void start()
+        {
+            // a parse that never finished did not publish its values
+            if (m_parsing)
+                drop();
+
+            m_pending = {};
+            m_flagless.clear();
+            clear_buffers();
+            std::fill(m_triggered.begin(), m_triggered.end(), 0);
+
+            // the arena may be published in a snapshot or hold values of the last parse, so it is never written again
+            if (!m_parsing && (m_arena.use_count() > 1 || !m_arena->empty()))
+            {
+                m_last_arena = std::move(m_arena);
+                m_arena = std::make_shared<Arena>();
+            }
+
+            m_parsing = true;
+        }
+
+        // drops the values finish groups so the next parse does not group them again
+        void clear_buffers()
+        {
+            m_occurrences.clear();
+            m_list_strings.clear();
+            m_list_numbers.clear();
+            m_list_floats.clear();
+            m_runs.clear();
+        }
+
+#ifdef FLAG_HAS_POSIX
+        // handles every NUL terminated argument in [pos, end). pos is left at the start of the first unterminated one
+        template <typename Visit>
+        Result parse_records(const char *&pos, const char *end, Visit &visit, bool copy)
+        {
+            while (const void *nul = std::memchr(pos, '\0', end - pos))
+            {
+                const char *next = static_cast<const char*>(nul) + 1;
+
+                Result result = record({pos, size_t(next - 1 - pos)}, visit, copy);
+
+                pos = next;
+
+                if (!result.ok)
+                    return result;
+            }
+
+            return {};
+        }
+
+        // handles one argument read by parse_fd. copies it first if flag data may point into it and its buffer will be reused
+        template <typename Visit>
+        Result record(std::string_view arg, Visit &visit, bool copy)
+        {
+            if (copy && (m_pending.index != npos || is_flag(arg)))
+                arg = m_owned.emplace_back(arg);
+
+            return step(arg, nullptr, m_pending, visit, nullptr);
+        }
+#endif
+
+        /*
+        * handles one argument. resolved is the flag index of the argument if it was already looked up.
+
+        * values are set right away, or recorded in chunk when called from a parse_parallel thread.
+        */
+        template <typename Visit>
+        Result step(std::string_view arg, const uint32_t *resolved, Pending &pending, Visit &visit, Chunk *chunk)
+        {
+            if (pending.index != npos)
+            {
+                uint32_t index = std::exchange(pending.index, npos);
+
+                return apply(index, pending.id, arg, chunk);
+            }
+
+            if (!is_flag(arg))
+            {
+                visit(arg);
+                return {};
+            }
+
+            size_t prefix_end = m_options.flag_prefix.size();
+
+            auto [sep_start, found_sep] = parse_flag(arg, prefix_end);
+
+            std::string_view id = arg.substr(prefix_end, sep_start - prefix_end);
+
+            uint32_t index = !resolved ? lookup_key(id) : *resolved == npos ? lookup_negated(id) : *resolved;
+
+            if (index == npos)
+            {
+                // -Dkey=value or --limit-key=value. the rest of the argument after the map flag prefix is the entry
+                if (auto [length, map_index] = match_map(id); length)
+                    return apply(map_index, id, arg.substr(prefix_end + length), chunk);
+
+                if (size_t length = cluster_length(id))
+                    return step_cluster(arg, prefix_end, length, pending, chunk);
+
+                if (m_options.strict_flags)
+                    return Result{false, id, "invalid flag id used"};
+
+                return {};
+            }
+
+            size_t value_start = sep_start + m_options.separator.size();
+
+            std::string_view value = found_sep && value_start < arg.size() ? arg.substr(value_start) : std::string_view{};
+
+            if (index & negated)
+            {
+                // --no-x=false would be a double negative
+                if (!value.empty())
+                    return Result{false, id, "could not set flag value"};
+
+                return apply(index & ~negated, id, "false", chunk);
+            }
+
+            if (is_switch(m_types[index]) || !value.empty())
+                return apply(index, id, value, chunk);
+
+            pending = {index, id};
+
+            return {};
+        }
+
+        Result apply(uint32_t index, std::string_view id, std::string_view value, Chunk *chunk)
+        {
+            if (!chunk)
+                return set_value(value, index, id);
+
+            chunk->events.push_back({index, id, value, chunk->positionals.size()});
+
+            return {};
+        }
+
+        // returns true if the argument is a flag that would use the next argument as its value
+        bool takes_value(std::string_view arg) const
+        {
+            if (!is_flag(arg))
+                return false;
+
+            size_t prefix_end = m_options.flag_prefix.size();
+
+            auto [sep_start, found_sep] = parse_flag(arg, prefix_end);
+
+            std::string_view id = arg.substr(prefix_end, sep_start - prefix_end);
+
+            uint32_t index = lookup_key(id);
+
+            if (index == npos && !match_map(id).first)
+            {
+                if (size_t length = cluster_length(id))
+                {
+                    index = m_short[uint8_t(id[length - 1])];
+
+                    return !is_switch(m_types[index]) && cluster_value(arg, prefix_end + length).empty();
+                }
+            }
+
+            if (index == npos || (index & negated) || is_switch(m_types[index]))
+                return false;
+
+            return !found_sep || sep_start + m_options.separator.size() >= arg.size();
+        }
+
+        /*
+        * looks up the flag ids of the arguments in [begin, end).
+
+        * every id is hashed and its bucket prefetched before any bucket is probed. values are looked up too since it is not known yet if they will be consumed.
+        */
+        void lookup_window(size_t begin, size_t end, uint32_t *out) const
+        {
+            std::string_view ids[lookahead];
+            uint64_t hashes[lookahead];
+
+            size_t prefix_end = m_options.flag_prefix.size();
+
+            for (size_t a = begin; a < end; a++)
+            {
+                std::string_view arg = m_args[a];
+
+                if (!is_flag(arg))
+                {
+                    ids[a - begin] = {};
+                    continue;
+                }
+
+                std::string_view id = arg.substr(prefix_end, parse_flag(arg, prefix_end).first - prefix_end);
+
+                ids[a - begin] = id;
+                hashes[a - begin] = Lookup::hash(id);
+
+                m_table.prefetch(hashes[a - begin]);
+            }
+
+            for (size_t i = 0; i < end - begin; i++)
+                out[i] = ids[i].data() ? m_table.index_of(ids[i], hashes[i]) : npos;
+        }
+
+        bool is_triggered(uint32_t index) const
+        {
+            return m_triggered[index / 64] & (uint64_t(1) << (index % 64));
+        }
+
+        bool is_flag(std::string_view str) const
+        {
+            size_t size = m_options.flag_prefix.size();
+
+            if (str.size() <= size)
+                return false;
+
+            for (size_t i = 0; i < size; i++)
+            {
+                if (str[i] != m_options.flag_prefix[i])
+                    return false;
+            }
+
+            return true;
+        }
+
+        // returns the position of the separator and whether it was found
+        std::pair<size_t, bool> parse_flag(std::string_view str, size_t offset = 0) const
+        {
+            std::string_view sep = m_options.separator;
+
+            size_t pos = sep.size() == 1 ? str.find(sep[0], offset) : str.find(sep, offset);
+
+            if (pos == std::string_view::npos)
+                return {str.size(), false};
+
+            return {pos, true};
+        }
+
+        Result set_value(std::string_view str, uint32_t index, std::string_view id)
+        {
+            if (is_triggered(index))
+            {
+                if (m_repeats[index] == FirstWins)
+                    return {};
+
+                if (m_repeats[index] == Reject)
+                    return Result{false, id, "flag used more than once"};
+            }
+
+            switch (m_types[index])
+            {
+                case String:
+                {
+                    if (const Validator *validator = find_validator(index))
+                    {
+                        if (std::string_view error = validator->check(str); !error.empty())
+                            return Result{false, id, error};
+                    }
+
+                    hold(index, str);
+
+                    break;
+                }
+                case Number: 
+                {
+                   
+                    double value{};
+
+                    auto result = std::from_chars(
+                        str.data(), 
+                        str.data()+str.size(), 
+                        value);
+
+                    if (result.ec != std::errc())
+                        return Result{false, id, "could not set flag value"};
+
+                    hold(index, value);
+
+                    break;
+                }
+                case Size:
+                case Duration:
+                {
+                    uint64_t value = 0;
+
+                    if (!parse_unit(str, m_types[index] == Size ? std::span<const Unit>(size_units) : duration_units, value))
+                        return Result{false, id, "could not set flag value"};
+
+                    hold(index, value);
+
+                    break;
+                }
+                case Choice:
+                {
+                    const Choices &choices = m_choices.at(index);
+
+                    uint32_t choice = choices.find(str);
+
+                    if (choice == npos)
+                        return Result{false, id, choices.error};
+
+                    hold(index, uint64_t(choice));
+
+                    break;
+                }
+                case Bool:
+                {
+                    bool value = true;
+
+                    if (!str.empty() && !parse_bool(str, value))
+                        return Result{false, id, "could not set flag value"};
+
+                    hold(index, value);
+
+                    break;
+                }
+                case Count:
+                {
+                    // a count is the number of times the flag is given so it can not be set directly
+                    if (!str.empty())
+                        return Result{false, id, "could not set flag value"};
+
+                    hold(index, is_triggered(index) ? std::get<uint64_t>(m_data[index]) + 1 : uint64_t(1));
+
+                    break;
+                }
+                case StringList:
+                case NumberList:
+                case NumberArray:
+                {
+                    std::string_view error = "could not set flag value";
+
+                    if (!split_list(str, index, error))
+                        return Result{false, id, error};
+
+                    break;
+                }
+                case Ranges:
+                {
+                    if (!add_ranges(str, index))
+                        return Result{false, id, "could not set flag value"};
+
+                    break;
+                }
+                case Map:
+                {
+                    if (!add_entry(str, index))
+                        return Result{false, id, "could not set flag value"};
+
+                    break;
+                }
+            }
+
+            // these flags already keep every value
+            if (m_repeats[index] == Accumulate && !appends(m_types[index]))
+                m_occurrences.emplace_back(index, m_data[index]);
+
+            m_triggered[index / 64] |= uint64_t(1) << (index % 64);
+            return {};
+        }
+
+        // parses a whole number followed by one of units into a count of the smallest unit. fails on an unknown suffix or overflow
+        static bool parse_unit(std::string_view str, std::span<const Unit> units, uint64_t &value)
+        {
+            const char *end = str.data() + str.size();
 
-    struct Flag;
+            auto result = std::from_chars(str.data(), end, value);
 
-    typedef Result (*FlagFn)(Flag&);
+            if (result.ec != std::errc())
+                return false;
 
-    struct Flag 
-    {
-        // the name of the flag
-        std::string_view name;
+            std::string_view suffix(result.ptr, size_t(end - result.ptr));
 
-        // the flag description
-        std::string_view description;
+            if (suffix.empty() && value == 0)
+                return true;
 
-        // the actual data of the flag. its also the default value if set.
-        FlagData data{};
+            for (const Unit &unit : units)
+            {
+                if (unit.suffix == suffix)
+                {
+                    if (value > UINT64_MAX / unit.scale)
+                        return false;
 
-        // the type of the flag. by default it will be Any
-        Type type = String;
+                    value *= unit.scale;
 
-        // the flag aliases
-        std::initializer_list<std::string_view> aliases;
+                    return true;
+                }
+            }
 
-        // the function that will be called when the flag is triggered. must call Parser::call.
-        FlagFn fn = nullptr;
+            return false;
+        }
 
-        // will be set to true if the flag is ever triggered
-        bool triggered = false;
+        // types where every use of the flag adds to its value instead of replacing it
+        static bool appends(Type type)
+        {
+            return type == StringList || type == NumberList || type == NumberArray || type == Ranges || type == Map || type == Count;
+        }
 
-    };
+        // adds key=value to the map of a Map flag. a key with no separator gets an empty value. the first use of the flag in a parse creates the map
+        bool add_entry(std::string_view str, uint32_t index)
+        {
+            auto [sep_start, found_sep] = parse_flag(str);
 
-    // a lookup table of flags. keys can be aliases or the flag name.
-    using FlagTable = std::unordered_map<std::string_view, Flag*>;
+            std::string_view key = str.substr(0, sep_start);
 
-    // a list of flags. uses a list instead of a vector to avoid invalidating the references of the lookup table as it resizes.
-    using Flags = std::list<Flag>;
+            if (key.empty())
+                return false;
 
-    struct Options 
-    {
-        // the prefix used for all flag names
-        std::string_view flag_prefix = "-";
-        // the characters that will be used to separate the flag name and value
-        std::string_view separator = "=";
-        // when set to true the parse function will fail when an incorrect flag is used
-        bool strict_flags = true;
-    };
+            std::string_view value = found_sep ? str.substr(sep_start + m_options.separator.size()) : std::string_view{};
 
-    class Parser 
-    {
-    public:
+            bool first_use = !is_triggered(index);
 
-        using View     = std::span<char*>;
-        using Flagless = std::vector<std::string_view>;
+            // once triggered the map was made by this parse in its own arena, which start never lets be a published one, so it is fine to change it
+            FlatMap *map = first_use ? &m_arena->maps.emplace_back() : const_cast<FlatMap*>(std::get<const FlatMap*>(m_data[index]));
 
-        Parser(View args, Options options) :
-            m_options(options),
-            m_args(args)
+            map->insert(key, value);
+
+            if (first_use)
+                hold(index, static_cast<const FlatMap*>(map));
+
+            return true;
+        }
+
+        /*
+        * adds ranges like 0-3,8,12-15 to the set of a Ranges flag. the first use of the flag in a parse creates the set in the arena, replacing the default.
+
+        * the value is checked and its largest bound found before the set is touched, so a bad value leaves it unchanged and the bitmap grows once.
+        */
+        bool add_ranges(std::string_view str, uint32_t index)
         {
+            auto each = [&](auto &&fn) -> bool
+            {
+                const char *pos = str.data();
+                const char *end = pos + str.size();
+
+                for (;;)
+                {
+                    uint32_t first, last;
+
+                    auto result = std::from_chars(pos, end, first);
+
+                    if (result.ec != std::errc())
+                        return false;
+
+                    pos = result.ptr;
+                    last = first;
+
+                    if (pos < end && *pos == '-')
+                    {
+                        result = std::from_chars(pos + 1, end, last);
+
+                        if (result.ec != std::errc() || last < first)
+                            return false;
+
+                        pos = result.ptr;
+                    }
+
+                    if (last >= RangeSet::limit)
+                        return false;
+
+                    fn(first, last);
+
+                    if (pos == end)
+                        return true;
+
+                    if (*pos++ != m_options.list_separator)
+                        return false;
+                }
+            };
+
+            uint32_t max = 0;
+
+            if (!each([&](uint32_t, uint32_t last) { max = std::max(max, last); }))
+                return false;
+
+            bool first_use = !is_triggered(index);
+
+            // once triggered the set was made by this parse in its own arena, which start never lets be a published one, so it is fine to change it
+            RangeSet *set = first_use ? &m_arena->range_sets.emplace_back() : const_cast<RangeSet*>(std::get<const RangeSet*>(m_data[index]));
+
+            set->reserve(max + 1);
+
+            each([&](uint32_t first, uint32_t last) { set->insert(first, last); });
+
+            if (first_use)
+                hold(index, static_cast<const RangeSet*>(set));
+
+            return true;
         }
 
-        Parser& set(Flag &&flag)
+        // appends the elements of a list value to the list arena of its type. error is set to the message of a failed string check
+        bool split_list(std::string_view str, uint32_t index, std::string_view &error)
         {
-            Flag &f = m_flags.emplace_back(flag);
+            switch (m_types[index])
+            {
+                case NumberList:
+                    return split_into(str, index, m_list_numbers, [](const char *pos, const char *end, double &value)
+                    {
+                        auto result = std::from_chars(pos, end, value);
+
+                        return result.ec == std::errc() && result.ptr == end;
+                    });
+                case NumberArray:
+                    return split_into(str, index, m_list_floats, parse_float);
+                default:
+                    return split_into(str, index, m_list_strings, [validator = find_validator(index), &error](const char *pos, const char *end, std::string_view &value)
+                    {
+                        value = {pos, size_t(end - pos)};
 
-            m_table.emplace(flag.name, &f);
+                        if (!validator)
+                            return true;
 
-            for (auto alias : f.aliases)
-                m_table.emplace(alias, &f);
+                        std::string_view message = validator->check(value);
 
-            return *this;
+                        if (!message.empty())
+                            error = message;
+
+                        return message.empty();
+                    });
+            }
         }
 
-        Result parse()
+        template <typename T, typename Convert>
+        bool split_into(std::string_view str, uint32_t index, std::vector<T> &list, Convert convert)
         {
-            m_flagless.reserve(m_args.size());
+            size_t offset = list.size();
 
-            for (size_t a = 0; a < m_args.size(); a++)
+            const char *pos = str.data();
+            const char *end = pos + str.size();
+
+            for (;;)
             {
-                std::string_view arg = m_args[a];
+                auto next = static_cast<const char*>(std::memchr(pos, m_options.list_separator, end - pos));
+                const char *stop = next ? next : end;
 
-                if (!is_flag(arg))
+                T value{};
+
+                if (!convert(pos, stop, value))
                 {
-                    m_flagless.push_back(arg);
-                    continue;
+                    list.resize(offset);
+                    return false;
                 }
 
-                size_t prefix_end = m_options.flag_prefix.size();
+                list.push_back(value);
 
-                auto [sep_start, found_sep] = parse_flag(arg, prefix_end);
+                if (!next)
+                    break;
 
-                std::string_view id = arg.substr(prefix_end, sep_start - prefix_end);
+                pos = next + 1;
+            }
 
-                auto flag_opt = get(id);
+            m_runs.push_back({index, uint32_t(offset), uint32_t(list.size() - offset)});
 
-                if (!flag_opt.has_value())
-                {
-                    if (m_options.strict_flags)
-                        return Result{false, id, "invalid flag id used"};
-                    else continue;
-                }
+            return true;
+        }
 
-                Flag *flag = flag_opt.value();
+        /*
+        * parses a float in [pos, end).
 
-                if (flag->type == Bool)
-                {
-                    flag->data = true;
-                    flag->triggered = true;
-                    continue;
-                }
+        * short decimals take an exact fast path: up to 24 bits of mantissa scaled by at most 10^10 is correctly rounded by one float multiply or divide. digits are read 8 at a time when possible. anything else falls back to std::from_chars.
+        */
+        static bool parse_float(const char *pos, const char *end, float &value)
+        {
+            static constexpr float powers[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
 
-                std::string_view value_str;
+            const char *start = pos;
 
-                Result fail_result {false, id, "could not set flag value"};
+            bool negative = pos < end && *pos == '-';
+            pos += negative;
 
-                if (found_sep && ++sep_start < arg.size())
-                    value_str = arg.substr(sep_start);
-                else if (a+1 < m_args.size())
-                    value_str = m_args[++a];
-                else
-                    return fail_result;
-                
-                bool ok = set_value(value_str, *flag);
+            uint64_t mantissa = 0;
+            int digits = 0;
+
+            read_digits(pos, end, mantissa, digits);
+
+            int exponent = 0;
+
+            if (pos < end && *pos == '.')
+            {
+                const char *fraction = ++pos;
+                read_digits(pos, end, mantissa, digits);
+                exponent = -int(pos - fraction);
+            }
+
+            if (pos == end && digits > 0 && digits <= 19 && mantissa <= (1 << 24) && exponent >= -10)
+            {
+                float result = float(mantissa) / powers[-exponent];
+                value = negative ? -result : result;
 
-                if (!ok)
-                    return fail_result;
+                return true;
             }
 
-            return Result{};
+            auto result = std::from_chars(start, end, value);
+
+            return result.ec == std::errc() && result.ptr == end;
         }
 
-        // calls all flag functions. returns the first result that has an error.
-        Result call()
+        // reads decimal digits into mantissa, 8 at a time while it can. stops early once there are too many digits for the fast path
+        static void read_digits(const char *&pos, const char *end, uint64_t &mantissa, int &digits)
         {
-            for (Flag &flag : m_flags)
+            if constexpr (std::endian::native == std::endian::little)
             {
-                if (flag.triggered && flag.fn)
+                while (end - pos >= 8 && digits + 8 <= 19)
                 {
-                    Result result = (*flag.fn)(flag);
+                    uint64_t chunk;
+                    std::memcpy(&chunk, pos, 8);
 
-                    if (!result.ok)
-                        return result;
+                    // every byte is within '0' to '9'
+                    if (((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) != 0x3333333333333333)
+                        break;
+
+                    chunk -= 0x3030303030303030;
+                    chunk = (chunk * 10) + (chunk >> 8);
+                    chunk = (((chunk & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) + (((chunk >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+
+                    mantissa = mantissa * 100000000 + chunk;
+                    digits += 8;
+                    pos += 8;
                 }
             }
 
-            return {};
+            for (; pos < end && *pos >= '0' && *pos <= '9' && digits < 20; pos++, digits++)
+                mantissa = mantissa * 10 + (*pos - '0');
+        }
+
+        // copies the runs of every list flag next to each other in the arena and points the flag data at them
+        void group_lists()
+        {
+            if (m_runs.empty() && !m_last_arena)
+                return;
+
+            Arena &arena = *m_arena;
+
+            group_runs(StringList, m_list_strings, arena.strings, 1);
+            group_runs(NumberList, m_list_numbers, arena.numbers, 1);
+            // 16 floats so every array starts on its own 64 byte boundary
+            group_runs(NumberArray, m_list_floats, arena.floats, 16);
         }
 
         /*
-        * returns an array of flags
+        * groups the runs of flags of one list type. each list starts at a multiple of align elements.
 
-        * this is where the actual data is stored
+        * lists of flags that were not given in this parse are copied over from the arena of the last one.
         */
-        Flags& flags()
+        template <typename T, typename Buffer>
+        void group_runs(Type type, const std::vector<T> &list, Buffer &grouped, size_t align)
         {
-            return m_flags;
-        }
+            if (list.empty() && !m_last_arena)
+                return;
 
-        /* 
-        * returns a lookup table for flags
+            std::vector<uint32_t> begin(m_flags.size(), 0);
 
-        * both aliases and flag names can be used to lookup a flag
+            for (const Run &run : m_runs)
+            {
+                if (m_types[run.index] == type)
+                    begin[run.index] += run.count;
+            }
 
-        * flag is returned as a pointer
-        */
-        FlagTable& table()
+            // flags without runs that hold a list other than their default
+            std::vector<uint32_t> carried;
+
+            if (m_last_arena)
+            {
+                for (size_t i = 0; i < m_flags.size(); i++)
+                {
+                    if (m_types[i] != type || is_triggered(i))
+                        continue;
+
+                    auto held = std::get<std::span<const T>>(m_data[i]);
+
+                    if (!held.empty() && held.data() != std::get<std::span<const T>>(m_defaults[i]).data())
+                    {
+                        begin[i] = held.size();
+                        carried.push_back(i);
+                    }
+                }
+            }
+
+            size_t total = 0;
+
+            for (size_t i = 0; i < m_flags.size(); i++)
+            {
+                if (m_types[i] != type)
+                    continue;
+
+                uint32_t count = begin[i];
+
+                begin[i] = total;
+                total += (count + align - 1) / align * align;
+            }
+
+            grouped.resize(total);
+
+            std::vector<uint32_t> end = begin;
+
+            for (const Run &run : m_runs)
+            {
+                if (m_types[run.index] != type)
+                    continue;
+
+                std::copy_n(list.begin() + run.offset, run.count, grouped.begin() + end[run.index]);
+                end[run.index] += run.count;
+            }
+
+            for (uint32_t i : carried)
+            {
+                auto held = std::get<std::span<const T>>(m_data[i]);
+
+                std::copy(held.begin(), held.end(), grouped.begin() + end[i]);
+                end[i] += held.size();
+            }
+
+            for (size_t i = 0; i < m_flags.size(); i++)
+            {
+                if (m_types[i] != type || end[i] == begin[i])
+                    continue;
+
+                // flags that were given are written out by publish. carried ones are not triggered so they are written here
+                std::span<const T> grouped_list(grouped.data() + begin[i], end[i] - begin[i]);
+
+                if (is_triggered(i))
+                    hold(i, grouped_list);
+                else
+                    store(i, grouped_list);
+            }
+        }
+
+        // copies the sets and maps of flags that were not given in this parse over from the arena of the last one
+        void carry_sets()
         {
-            return m_table;
+            for (size_t i = 0; i < m_flags.size(); i++)
+            {
+                if (is_triggered(i))
+                    continue;
+
+                if (m_types[i] == Ranges)
+                    carry(i, m_arena->range_sets);
+                else if (m_types[i] == Map)
+                    carry(i, m_arena->maps);
+            }
         }
 
-        // a shorthand for looking up flags by alias or name. checks to see if the flag is valid beforehand and returns an optional to the flag pointer.
-        std::optional<Flag*> get(std::string_view id) const
+        template <typename T>
+        void carry(uint32_t index, std::deque<T> &pool)
         {
-            auto it = m_table.find(id);
+            const T *held = std::get<const T*>(m_data[index]);
 
-            if (it == m_table.end())
-                return {};
+            if (held && held != std::get<const T*>(m_defaults[index]))
+                store(index, static_cast<const T*>(&pool.emplace_back(*held)));
+        }
+
+        // the default of Ranges flags so an unset flag can be read like one that was given
+        static inline const RangeSet no_ranges{};
+        // the default of Map flags
+        static inline const FlatMap no_entries{};
 
-            return { it->second };
+        // the value a flag of the given type holds before it is set
+        static FlagData empty_value(Type type)
+        {
+            switch (type)
+            {
+                case Number:     return 0.0;
+                case Bool:       return false;
+                case StringList: return std::span<const std::string_view>{};
+                case NumberList: return std::span<const double>{};
+                case NumberArray: return std::span<const float>{};
+                case Ranges:      return &no_ranges;
+                case Map:         return &no_entries;
+                case Size:
+                case Duration:
+                case Choice:
+                case Count:       return uint64_t{0};
+                default:         return std::string_view{};
+            }
         }
 
-        std::string to_string() const 
+        // groups accumulated values by flag with a counting sort so each flag gets one contiguous span
+        void group_values()
         {
-            std::string output;
+            m_values.clear();
+            m_ranges.clear();
 
-            for (const Flag &flag : m_flags)
+            if (m_occurrences.empty())
+                return;
+
+            m_ranges.assign(m_flags.size(), {0, 0});
+
+            for (auto &[index, value] : m_occurrences)
+                m_ranges[index].second++;
+
+            uint32_t offset = 0;
+
+            for (auto &[start, count] : m_ranges)
             {
-                output += m_options.flag_prefix;
-                output += flag.name;
-                output += "\t\t";
-                output += flag.description;
-                output += "\n";
+                start = offset;
+                offset += count;
             }
 
-            return output;
+            m_values.resize(m_occurrences.size());
+
+            std::vector<uint32_t> filled(m_flags.size(), 0);
+
+            for (auto &[index, value] : m_occurrences)
+                m_values[m_ranges[index].first + filled[index]++] = value;
         }
 
-        // returns the arguments without flags
-        Flagless& args()
+        // true if the flag was given a default. a null view is the data of a flag that gave none, and a Choice default can be a name
+        static bool has_default(const Flag &flag, const FlagData &empty)
         {
-            return m_flagless;
+            if (auto name = std::get_if<std::string_view>(&flag.data))
+                return name->data() && (flag.type == String || flag.type == Choice);
+
+            return flag.data.index() == empty.index();
         }
 
-        Options& options()
+        // makes the value of a bound variable the default of its flag
+        template <typename T>
+        static void load(Flag &flag, T target)
         {
-            return m_options;
+            if constexpr (!std::is_same_v<T, std::monostate>)
+            {
+                if (target)
+                    flag.data = *target;
+            }
         }
 
-    private:
-        Flags m_flags;
-        FlagTable m_table;
-        Options m_options;
-        View m_args;
-        Flagless m_flagless;
-
-        bool is_flag(std::string_view str) const
+        // sets the value of a flag while parsing. publish writes it to the flag and its target once the parse is done
+        template <typename T>
+        void hold(uint32_t index, T value)
         {
-            size_t size = m_options.flag_prefix.size();
+            m_data[index] = value;
+        }
 
-            if (str.size() <= size)
-                return false;
+        // sets the value of a flag everywhere it is kept
+        template <typename T>
+        void store(uint32_t index, T value)
+        {
+            m_data[index] = value;
+            store(m_flags[index], value);
+        }
 
-            for (size_t i = 0; i < size; i++)
+        // fails if the last flag is still waiting for its value, a flag was set with a bad schema or a constraint is broken
+        Result check_parse()
+        {
+            if (m_pending.index != npos)
             {
-                if (str[i] != m_options.flag_prefix[i])
-                    return false;
+                m_pending.index = npos;
+
+                return Result{false, m_pending.id, "could not set flag value"};
             }
 
-            return true; 
+            if (!m_schema_error.ok)
+                return m_schema_error;
+
+            return check_constraints();
         }
 
-        std::pair<size_t, bool> parse_flag(std::string_view str, size_t offset = 0)
+        // forgets the flags given in a parse that failed or never finished. their values go back to the ones their Flag shows
+        void drop()
         {
-            std::string_view sep = m_options.separator;
-
-            for (size_t i = offset; i < str.size(); i++)
+            for (size_t w = 0; w < m_triggered.size(); w++)
             {
-                if (str[i] == sep[0])
+                for (uint64_t bits = m_triggered[w]; bits; bits &= bits - 1)
                 {
-                    bool found = true;
-                    size_t j;
+                    size_t i = w * 64 + std::countr_zero(bits);
 
-                    for (j = i; j < sep.size(); j++, i++)
-                    {
-                        if (str[i] != sep[j])
-                            found = false;
-                    }
-
-                    if (found)
-                        return {j, true};
+                    m_data[i] = m_flags[i].data;
                 }
             }
 
-            return {str.size(), false};
+            std::fill(m_triggered.begin(), m_triggered.end(), 0);
+            clear_buffers();
         }
 
-        bool set_value(std::string_view str, Flag &flag)
+        // writes the values of the flags given in this parse to their Flag and target
+        void publish()
         {
-            switch (flag.type)
+            for (size_t w = 0; w < m_triggered.size(); w++)
             {
-                case String: flag.data = str; break;
-                case Number: 
+                for (uint64_t bits = m_triggered[w]; bits; bits &= bits - 1)
                 {
-                   
-                    double value{};
-
-                    auto result = std::from_chars(
-                        str.data(), 
-                        str.data()+str.size(), 
-                        value);
-
-                    if (result.ec != std::errc())
-                        return false;
+                    size_t i = w * 64 + std::countr_zero(bits);
+                    Flag &flag = m_flags[i];
 
-                    flag.data = value;
-
-                    break;
+                    if (flag.target.index() == 0)
+                        flag.data = m_data[i];
+                    else
+                        std::visit([&](auto value) { store(flag, value); }, m_data[i]);
                 }
             }
+        }
 
-            flag.triggered = true;
-            return true;
+        // writes the value to the flag and to its bound variable if there is one
+        template <typename T>
+        static void store(Flag &flag, T value)
+        {
+            flag.data = value;
+
+            if (auto target = std::get_if<T*>(&flag.target); target && *target)
+                **target = value;
         }
     };
-}
\ No newline at end of file
+
+    using Parser = BasicParser<>;
+}
+
+/*
+* defines a flag at namespace scope that is added to a parser by Parser::set_registered.
+
+* the registration is linked in by an object defined right after it, so it is always initialized first. the registry head is constinit so no other ordering matters.
+
+* FLAG_DEFINE(verbose, { .name = "verbose", .type = flag::Bool });
+*/
+#define FLAG_DEFINE(var, ...) \
+    ::flag::Registration var{ __VA_ARGS__ }; \
+    static const ::flag::Registrar var##_registrar{ var }